@@ -0,0 +1,304 @@
+// PDBDatabase.h
+//
+// Binary symbol database written by PDBToJSON --database next to a dump (<dump>.pdbdb), and a
+// reader for it. The file is laid out to be memory-mapped and queried in place: a fixed header
+// locates the sections, every record has a fixed size and 8-byte alignment, and strings are
+// offsets into one string table, so opening a database only checks the header.
+//
+// All integers are little-endian. Sections follow the header in this order:
+//  - strings:      NUL-terminated UTF-8 strings; offset 0 is the empty string
+//  - types:        PdbDbType, one per distinct type name
+//  - symbols:      PdbDbSymbol, one per class, enum, global function, global variable and typedef
+//  - members:      PdbDbMember; each symbol owns a contiguous run of them
+//  - name index:   PdbDbIndexEntry sorted by the PdbDbHashName hash of the symbol names
+//  - address index: PdbDbAddressEntry of the functions and variables that cover an address range
+//                   [virtualOffset, virtualOffset + size), sorted by virtualOffset. Each entry
+//                   also holds the index of the last earlier entry whose range is still open
+//                   at its start, so a lookup only follows the chain of ranges enclosing the
+//                   last one that starts at or below the address. In the worst case it visits
+//                   every range open at that start: the nesting depth, not the index size.
+
+#pragma once
+
+#include <Windows.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+const char PdbDbMagic[8] = { 'P', 'D', 'B', 'J', 'S', 'D', 'B', '\0' };
+
+// Bump when the layout or the meaning of any record changes
+const uint32_t PdbDbVersion = 4;
+
+// Index of "no type" in type references
+const uint32_t PdbDbNoType = 0xFFFFFFFF;
+
+// Index of "no entry" in PdbDbAddressEntry::enclosing
+const uint32_t PdbDbNoEntry = 0xFFFFFFFF;
+
+enum PdbDbSymbolKind : uint32_t {
+	PdbDbClass,
+	PdbDbEnum,
+	PdbDbFunction,
+	PdbDbGlobal,
+	PdbDbTypedef,
+};
+
+enum PdbDbMemberKind : uint32_t {
+	PdbDbBaseClass,
+	PdbDbField,
+	PdbDbMethod,
+	PdbDbParameter, // Follows its method, or belongs directly to a global function
+	PdbDbEnumValue,
+};
+
+enum PdbDbFlags : uint32_t {
+	PdbDbIsVirtual = 1,       // Virtual methods and virtual base classes
+	PdbDbIsPureVirtual = 2,
+	PdbDbIsStatic = 4,
+	PdbDbIsConst = 8,
+	PdbDbIsBitField = 16,     // bitPosition and bitWidth are set
+	PdbDbHasVirtualSlot = 32, // virtualTableOffset is set
+};
+
+struct PdbDbSection {
+	uint64_t offset; // From the start of the file
+	uint64_t count;  // Records, or bytes for the string table
+};
+
+struct PdbDbHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	PdbDbSection strings;
+	PdbDbSection types;
+	PdbDbSection symbols;
+	PdbDbSection members;
+	PdbDbSection nameIndex;
+	PdbDbSection addressIndex;
+};
+
+struct PdbDbType {
+	uint32_t name;
+	uint32_t reserved;
+	uint64_t typeId; // "TypeId" of the dump with --type-descriptors, otherwise 0
+};
+
+struct PdbDbSymbol {
+	uint32_t kind;          // PdbDbSymbolKind
+	uint32_t name;
+	uint32_t sourceFile;
+	uint32_t lineNumber;
+	uint64_t size;          // Class size, function code length or variable size
+	uint64_t virtualOffset; // Functions and variables
+	uint32_t type;          // Variable type, or enum and typedef underlying type
+	uint32_t flags;         // PdbDbFlags
+	uint32_t firstMember;
+	uint32_t memberCount;
+};
+
+struct PdbDbMember {
+	uint32_t kind;           // PdbDbMemberKind
+	uint32_t name;
+	uint32_t type;
+	uint32_t flags;          // PdbDbFlags
+	int64_t offset;          // Byte offset of bases and fields, or the value of an enum value
+	uint64_t virtualOffset;
+	uint32_t bitPosition;
+	uint32_t bitWidth;
+	uint32_t virtualTableOffset;
+	uint32_t parameterCount; // Methods: PdbDbParameter members that follow
+};
+
+struct PdbDbIndexEntry {
+	uint64_t key;
+	uint32_t symbol;
+	uint32_t reserved;
+};
+
+struct PdbDbAddressEntry {
+	uint64_t start;
+	uint64_t end;       // One past the last address of the range
+	uint32_t symbol;
+	uint32_t enclosing; // Last earlier entry whose range covers `start`, or PdbDbNoEntry
+};
+
+// 64-bit FNV-1a of a UTF-8 name, the key of the name index
+inline uint64_t PdbDbHashName(const char* name, size_t length) {
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= static_cast<unsigned char>(name[i]);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// Read-only view of a database, either mapped from a file by Open or attached to memory the
+// caller owns. Records are returned in place and stay valid until Close.
+class PDBDatabase {
+public:
+	static const uint32_t NotFound = 0xFFFFFFFF;
+
+	PDBDatabase() = default;
+	PDBDatabase(const PDBDatabase&) = delete;
+	PDBDatabase& operator=(const PDBDatabase&) = delete;
+	~PDBDatabase() { Close(); }
+
+	bool Open(const wchar_t* path) {
+		Close();
+		file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+			mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping)
+				view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		}
+		if (!view || !Attach(view, static_cast<size_t>(fileSize.QuadPart))) {
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	// Checks the header and that every section lies within `size` bytes
+	bool Attach(const void* data, size_t size) {
+		base = static_cast<const char*>(data);
+		header = nullptr;
+		if (size < sizeof(PdbDbHeader))
+			return false;
+
+		const PdbDbHeader* candidate = reinterpret_cast<const PdbDbHeader*>(base);
+		if (memcmp(candidate->magic, PdbDbMagic, sizeof(PdbDbMagic)) != 0 || candidate->version != PdbDbVersion ||
+			candidate->headerSize != sizeof(PdbDbHeader))
+			return false;
+		if (!FitsIn(candidate->strings, 1, size) || !FitsIn(candidate->types, sizeof(PdbDbType), size) ||
+			!FitsIn(candidate->symbols, sizeof(PdbDbSymbol), size) || !FitsIn(candidate->members, sizeof(PdbDbMember), size) ||
+			!FitsIn(candidate->nameIndex, sizeof(PdbDbIndexEntry), size) || !FitsIn(candidate->addressIndex, sizeof(PdbDbAddressEntry), size))
+			return false;
+		if (candidate->strings.count == 0 || base[candidate->strings.offset + candidate->strings.count - 1] != '\0')
+			return false;
+
+		header = candidate;
+		return true;
+	}
+
+	void Close() {
+		if (view)
+			UnmapViewOfFile(view);
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		view = nullptr;
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+		header = nullptr;
+		base = nullptr;
+	}
+
+	bool IsOpen() const { return header != nullptr; }
+
+	uint32_t GetSymbolCount() const { return static_cast<uint32_t>(header->symbols.count); }
+	const PdbDbSymbol& GetSymbol(uint32_t index) const { return Section<PdbDbSymbol>(header->symbols)[index]; }
+
+	// Members of a symbol, `symbol.memberCount` of them
+	const PdbDbMember* GetMembers(const PdbDbSymbol& symbol) const {
+		return Section<PdbDbMember>(header->members) + symbol.firstMember;
+	}
+
+	const char* GetString(uint32_t offset) const { return base + header->strings.offset + offset; }
+
+	const char* GetTypeName(uint32_t type) const {
+		return type == PdbDbNoType ? "" : GetString(Section<PdbDbType>(header->types)[type].name);
+	}
+
+	// First symbol with the given name, or NotFound; pass the result back as `after` for the next
+	uint32_t FindByName(const char* name, uint32_t after = NotFound) const {
+		size_t length = strlen(name);
+		uint64_t hash = PdbDbHashName(name, length);
+		const PdbDbIndexEntry* begin = Section<PdbDbIndexEntry>(header->nameIndex);
+		const PdbDbIndexEntry* end = begin + header->nameIndex.count;
+		const PdbDbIndexEntry* entry = std::lower_bound(begin, end, hash, [](const PdbDbIndexEntry& indexEntry, uint64_t key) {
+			return indexEntry.key < key;
+		});
+
+		// Entries of one hash are in symbol order, so skip up to `after`
+		for (; entry != end && entry->key == hash; ++entry) {
+			if (after != NotFound && entry->symbol <= after)
+				continue;
+			const char* symbolName = GetString(GetSymbol(entry->symbol).name);
+			if (strlen(symbolName) == length && memcmp(symbolName, name, length) == 0)
+				return entry->symbol;
+		}
+		return NotFound;
+	}
+
+	// Function or variable whose range covers `address`, or NotFound. Of nested ranges, the one
+	// that starts last is returned.
+	uint32_t FindByAddress(uint64_t address) const {
+		const PdbDbAddressEntry* begin = Section<PdbDbAddressEntry>(header->addressIndex);
+		const PdbDbAddressEntry* end = begin + header->addressIndex.count;
+		const PdbDbAddressEntry* entry = std::upper_bound(begin, end, address, [](uint64_t key, const PdbDbAddressEntry& addressEntry) {
+			return key < addressEntry.start;
+		});
+		return Covering(begin, entry, address);
+	}
+
+	// FindByAddress for `count` addresses at once, results in `symbols`. The addresses are
+	// visited in sorted order, so the index is walked forward once instead of searched for each.
+	void FindByAddresses(const uint64_t* addresses, size_t count, uint32_t* symbols) const {
+		std::vector<size_t> order(count);
+		for (size_t i = 0; i < count; i++)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return addresses[a] < addresses[b]; });
+
+		const PdbDbAddressEntry* begin = Section<PdbDbAddressEntry>(header->addressIndex);
+		const PdbDbAddressEntry* end = begin + header->addressIndex.count;
+		const PdbDbAddressEntry* next = begin; // First entry above the previous address
+		for (size_t i : order) {
+			uint64_t address = addresses[i];
+			while (next != end && next->start <= address)
+				++next;
+			symbols[i] = Covering(begin, next, address);
+		}
+	}
+
+private:
+	// The symbol of the last entry before `after` whose range covers `address`, where `after` is
+	// the first entry starting above it. Any earlier range that covers the address also covers
+	// the start of the entry before `after`, so only that entry's enclosing chain is walked.
+	static uint32_t Covering(const PdbDbAddressEntry* begin, const PdbDbAddressEntry* after, uint64_t address) {
+		if (after == begin)
+			return NotFound;
+		uint32_t index = static_cast<uint32_t>(after - begin - 1);
+		for (;;) {
+			const PdbDbAddressEntry& entry = begin[index];
+			if (address < entry.end)
+				return entry.symbol;
+			// Enclosing entries always come earlier, which also ends the walk at PdbDbNoEntry
+			if (entry.enclosing >= index)
+				return NotFound;
+			index = entry.enclosing;
+		}
+	}
+
+	template<typename T>
+	const T* Section(const PdbDbSection& section) const {
+		return reinterpret_cast<const T*>(base + section.offset);
+	}
+
+	static bool FitsIn(const PdbDbSection& section, size_t recordSize, size_t size) {
+		return section.offset <= size && section.count <= (size - section.offset) / recordSize &&
+			(recordSize == 1 || section.offset % 8 == 0);
+	}
+
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+	void* view = nullptr;
+	const char* base = nullptr;
+	const PdbDbHeader* header = nullptr;
+};
@@ -12,724 +12,6287 @@
 #include <sstream> // For std::wstringstream
 #include <iomanip> // For std::setprecision
 #include <mutex>   // For std::mutex
+#include <algorithm> // For std::sort
+#include <unordered_set>
+#include <map>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <climits>
+#include <cstring>
+#include <condition_variable>
+#include <functional>
+#include <filesystem>
+#include <memory_resource>
+#include <string_view>
 
 // Include the nlohmann/json library
 #include "json.hpp"
 
 using json = nlohmann::json;
 
+// Binary database format shared with the reader shipped alongside
+#include "PDBDatabase.h"
+
+// String that only lives while one top-level symbol is processed; see ScratchArena
+typedef std::pmr::wstring ScratchWString;
+
 // Link against the DIA SDK library
 #pragma comment(lib, "diaguids.lib")
 
+// SSE2 is always available on x86 and x64; AVX2 is used only when the CPU reports it
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PDBTOJSON_X86_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PDBTOJSON_TARGET_AVX2
+#else
+#define PDBTOJSON_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Define PDBTOJSON_COUNT_ALLOCATIONS to have benchmarks report heap allocations
+#ifdef PDBTOJSON_COUNT_ALLOCATIONS
+std::atomic<ULONGLONG> heapAllocationCount(0);
+std::atomic<ULONGLONG> heapAllocationBytes(0);
+
+void* operator new(size_t size) {
+	heapAllocationCount++;
+	heapAllocationBytes += size;
+	if (void* p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+#endif
+
 // Function prototypes
-void EnumerateSymbols(CComPtr<IDiaSymbol> pGlobal, json& output, const std::wstring& filePrefix);
-void ProcessUDT(CComPtr<IDiaSymbol> pSymbol, json& classesArray, const std::wstring& filePrefix, LONG totalSymbols, LONG& processedSymbols, double& lastProgressPercentage);
-void ProcessEnum(CComPtr<IDiaSymbol> pSymbol, json& enumsArray, const std::wstring& filePrefix, LONG totalSymbols, LONG& processedSymbols, double& lastProgressPercentage);
-void ProcessTypedef(CComPtr<IDiaSymbol> pSymbol, json& typedefsArray, LONG totalSymbols, LONG& processedSymbols, double& lastProgressPercentage);
-void ProcessFunction(CComPtr<IDiaSymbol> pSymbol, json& functionsArray, const std::wstring& filePrefix, LONG totalSymbols, LONG& processedSymbols, double& lastProgressPercentage);
-void ProcessData(CComPtr<IDiaSymbol> pSymbol, json& globalsArray, const std::wstring& filePrefix, LONG totalSymbols, LONG& processedSymbols, double& lastProgressPercentage);
+struct SessionContext;
+struct NamePools;
+struct SymbolArrays;
+class SymbolFilter;
+class ThreadPool;
+class DatabaseBuilder;
+bool OpenPdbSession(const std::wstring& pdbPath, SessionContext& context);
+bool DumpPdb(const std::wstring& pdbPath, const std::wstring& outputPath, const SymbolFilter& filter, ThreadPool* pool, bool reportProgress, LONG& symbolCount, bool& servedFromCache);
+bool EnumerateSymbols(const std::wstring& pdbPath, SessionContext& mainContext, std::ostream& out, std::ostream* recordsOut, DatabaseBuilder* database, const SymbolFilter& filter, ThreadPool* pool, bool reportProgress, LONG& symbolCount);
+int RunBatch(const std::wstring& batchSource, const SymbolFilter& filter);
+bool CollectBatchInputs(const std::wstring& batchSource, std::vector<std::wstring>& pdbPaths);
+int RunDiff(const std::wstring& oldPath, const std::wstring& newPath, const SymbolFilter& filter);
+int RunSymbolize(const std::wstring& databasePath, const std::wstring& addressesPath);
+struct KindSpool;
+class RecordSpool;
+class RecordStore;
+template <typename T> class BoundedQueue;
+size_t SerializeChunk(SymbolArrays& arrays, std::string& classesText, KindSpool& spool, std::ostream* recordsOut, DatabaseBuilder* database);
+bool WriteSpooledArray(BoundedQueue<std::string>& writeQueue, const char* key, RecordSpool& records);
+void AppendIndented(std::string& out, const json& value, size_t indent);
+void AppendArrayElement(std::string& out, const json& value, bool& first);
+void ProcessChunk(IDiaEnumSymbols* pEnumSymbols, size_t chunk, size_t totalSymbols, SymbolArrays& arrays, const SymbolFilter& filter, std::atomic<LONG>& processedSymbols);
+void ProcessChunk(const std::vector<CComPtr<IDiaSymbol>>& symbols, size_t chunk, SymbolArrays& arrays, const SymbolFilter& filter, std::atomic<LONG>& processedSymbols);
+void ProcessSymbol(IDiaSymbol* pSymbol, SymbolArrays& arrays, const SymbolFilter& filter);
+bool LoadRootNames(const std::wstring& path, std::vector<std::wstring>& rootNames);
+void CollectReachableTypes(SessionContext& context, const SymbolFilter& filter, std::vector<CComPtr<IDiaSymbol>>& types);
+void UpdateProgress(LONG processedSymbols, LONG totalSymbols, double& lastProgressPercentage);
+void ProcessUDT(CComPtr<IDiaSymbol> pSymbol, SymbolArrays& arrays, const SymbolFilter& filter);
+void ProcessEnum(CComPtr<IDiaSymbol> pSymbol, SymbolArrays& arrays, const SymbolFilter& filter);
+void ProcessTypedef(CComPtr<IDiaSymbol> pSymbol, json& typedefsArray, const SymbolFilter& filter);
+void ProcessFunction(CComPtr<IDiaSymbol> pSymbol, SymbolArrays& arrays, const SymbolFilter& filter);
+void ProcessData(CComPtr<IDiaSymbol> pSymbol, SymbolArrays& arrays, const SymbolFilter& filter);
+struct SourceLocation;
+json BuildParametersArray(IDiaSymbol* pFunction);
+struct ClassMemberHashes;
+ClassMemberHashes HashClassMembers(IDiaSymbol* pUDT);
+ULONGLONG HashClassRecord(IDiaSymbol* pUDT, const std::wstring& name, ULONGLONG length, const SourceLocation& location, ULONGLONG& fieldHash);
+ULONGLONG HashEnumRecord(IDiaSymbol* pEnum, const std::wstring& name, const SourceLocation& location);
+ULONGLONG HashFunctionRecord(IDiaSymbol* pFunction, const std::wstring& name, const SourceLocation& location);
+ULONGLONG GetOutputOptionsHash(const SymbolFilter& filter);
+void SetSourceLocationFields(json& object, const SourceLocation& location);
 
 std::wstring GetSymbolName(CComPtr<IDiaSymbol> pSymbol);
-std::wstring GetSymbolFileName(CComPtr<IDiaSymbol> pSymbol);
-DWORD GetSymbolLineNumber(CComPtr<IDiaSymbol> pSymbol);
+ScratchWString GetScratchName(IDiaSymbol* pSymbol);
+struct InternedString;
+SourceLocation GetSourceLocation(IDiaSymbol* pSymbol);
+InternedString GetSourceFileName(IDiaSourceFile* pSourceFile);
+bool PassesFileFilter(const SourceLocation& location, const SymbolFilter& filter);
+bool PassesNameFilter(const std::wstring& name, const SymbolFilter& filter);
+bool IsInExcludedCompiland(IDiaSymbol* pSymbol, const SymbolFilter& filter);
+void FindExcludedCompilands(SessionContext& context, const SymbolFilter& filter);
 std::wstring GetUndecoratedName(CComPtr<IDiaSymbol> pSymbol);
+std::wstring GetQualifiedName(CComPtr<IDiaSymbol> pSymbol);
+std::wstring CanonicalizeTemplateName(const std::wstring& name);
+bool IsOperatorBracket(const std::wstring& name, size_t begin, size_t pos);
 std::wstring GetTypeName(CComPtr<IDiaSymbol> pType);
+struct ResolvedType;
+const ResolvedType& ResolveType(CComPtr<IDiaSymbol> pType);
 std::wstring GetBasicTypeName(DWORD baseType, DWORD length);
+ULONGLONG GetTypeId(CComPtr<IDiaSymbol> pType);
+void SetTypeField(json& object, const char* key, CComPtr<IDiaSymbol> pType);
+json BuildTypeDescriptorsArray(const std::vector<const SessionContext*>& contexts);
+ULONGLONG HashBytes(const void* data, size_t size, ULONGLONG hash = 14695981039346656037ULL);
+const char* GetSymTagName(DWORD symTag);
+struct VTableLayout;
+const VTableLayout& GetVTableLayout(CComPtr<IDiaSymbol> pUDT);
+std::wstring GetMethodSignature(CComPtr<IDiaSymbol> pFunction);
+DWORD GetPointerSize(CComPtr<IDiaSymbol> pGlobal);
+struct ClassLayout;
+const ClassLayout& GetClassLayout(CComPtr<IDiaSymbol> pUDT);
+json BuildFlattenedLayout(const ClassLayout& layout);
+void PrintUsage();
+void PrintStringPoolStats();
+int RunBenchmark(const std::wstring& benchmarkName, CComPtr<IDiaSymbol> pGlobal);
 
-std::string WStringToString(const std::wstring& wstr) {
-	if (wstr.empty())
-		return std::string();
+// UTF-16 to UTF-8 conversion. Symbol names are almost always ASCII, so runs of ASCII are
+// narrowed 16 or 32 code units at a time with SSE2 or AVX2, chosen once at startup, and only
+// the rest goes through the scalar encoder. Unpaired surrogates become U+FFFD, as with
+// WideCharToMultiByte.
+enum TranscodeLevel {
+	TranscodeScalar,
+	TranscodeSse2,
+	TranscodeAvx2,
+};
 
-	int sizeNeeded = WideCharToMultiByte(CP_UTF8, 0, wstr.c_str(), (int)wstr.size(), NULL, 0, NULL, NULL);
-	if (sizeNeeded <= 0)
-		return std::string();
+TranscodeLevel DetectTranscodeLevel() {
+#ifdef PDBTOJSON_X86_SIMD
+	// The vector paths assume 16-bit wchar_t
+	if (sizeof(wchar_t) != 2)
+		return TranscodeScalar;
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] >= 7) {
+		__cpuid(info, 1);
+		bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+		__cpuidex(info, 7, 0);
+		if (osSavesYmm && (info[1] & (1 << 5)) != 0)
+			return TranscodeAvx2;
+	}
+#else
+	if (__builtin_cpu_supports("avx2"))
+		return TranscodeAvx2;
+#endif
+	return TranscodeSse2;
+#else
+	return TranscodeScalar;
+#endif
+}
 
-	std::string strTo(sizeNeeded, 0);
-	int bytesConverted = WideCharToMultiByte(CP_UTF8, 0, wstr.c_str(), (int)wstr.size(), &strTo[0], sizeNeeded, NULL, NULL);
-	if (bytesConverted != sizeNeeded)
-		return std::string();
+const TranscodeLevel transcodeLevel = DetectTranscodeLevel();
 
-	return strTo;
+// Each copies the leading ASCII code units of src to dst and returns how many it copied
+size_t CopyAsciiScalar(const wchar_t* src, size_t length, char* dst) {
+	size_t i = 0;
+	for (; i < length && static_cast<uint32_t>(src[i]) < 0x80; i++)
+		dst[i] = static_cast<char>(src[i]);
+	return i;
 }
 
-// Global type name cache to optimize GetTypeName function
-std::unordered_map<ULONGLONG, std::wstring> typeNameCache;
-std::mutex cacheMutex; // Mutex for thread-safe access to the cache (if multithreading is implemented)
-
-int wmain(int argc, wchar_t* argv[]) {
-	if (argc < 2) {
-		std::wcerr << L"Usage: DumpPDB.exe <path-to-pdb-file> [file-prefix]" << std::endl;
-		return 1;
+#ifdef PDBTOJSON_X86_SIMD
+size_t CopyAsciiSse2(const wchar_t* src, size_t length, char* dst) {
+	const __m128i nonAsciiBits = _mm_set1_epi16(static_cast<short>(0xFF80));
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 16 <= length; i += 16) {
+		__m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		__m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+		__m128i nonAscii = _mm_and_si128(_mm_or_si128(low, high), nonAsciiBits);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(nonAscii, zero)) != 0xFFFF)
+			break;
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(low, high));
 	}
+	return i + CopyAsciiScalar(src + i, length - i, dst + i);
+}
 
-	// Get the file prefix filter from command-line arguments
-	std::wstring filePrefix;
-	if (argc >= 3) {
-		filePrefix = argv[2];
+PDBTOJSON_TARGET_AVX2
+size_t CopyAsciiAvx2(const wchar_t* src, size_t length, char* dst) {
+	const __m256i nonAsciiBits = _mm256_set1_epi16(static_cast<short>(0xFF80));
+	size_t i = 0;
+	for (; i + 32 <= length; i += 32) {
+		__m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+		__m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 16));
+		if (!_mm256_testz_si256(_mm256_or_si256(low, high), nonAsciiBits))
+			break;
+		// packus works per 128-bit lane, so the 64-bit quarters come out as low0 high0 low1 high1
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
 	}
-
-	// Initialize COM library
-	HRESULT hr = CoInitialize(NULL);
-	if (FAILED(hr)) {
-		std::wcerr << L"CoInitialize failed" << std::endl;
-		return 1;
+	// One 16-unit step for the tail, kept in this function so that it is VEX-encoded too
+	if (i + 16 <= length) {
+		__m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+		if (_mm256_testz_si256(tail, nonAsciiBits)) {
+			__m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(tail), _mm256_extracti128_si256(tail, 1));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+			i += 16;
+		}
 	}
+	return i + CopyAsciiScalar(src + i, length - i, dst + i);
+}
+#endif
 
-	CComPtr<IDiaDataSource> pSource;
-	hr = CoCreateInstance(__uuidof(DiaSource), NULL, CLSCTX_INPROC_SERVER,
-		__uuidof(IDiaDataSource), (void**)&pSource);
-	if (FAILED(hr)) {
-		std::wcerr << L"CoCreateInstance failed " << std::hex << hr << std::endl;
-		CoUninitialize();
-		return 1;
-	}
+// Converts length UTF-16 code units into dst, which must have room for 3 * length bytes, and
+// returns the number of bytes written
+size_t TranscodeUtf16ToUtf8(const wchar_t* src, size_t length, char* dst, TranscodeLevel level = transcodeLevel) {
+	char* out = dst;
+	size_t i = 0;
+	while (i < length) {
+		size_t asciiCount;
+#ifdef PDBTOJSON_X86_SIMD
+		if (level == TranscodeAvx2)
+			asciiCount = CopyAsciiAvx2(src + i, length - i, out);
+		else if (level == TranscodeSse2)
+			asciiCount = CopyAsciiSse2(src + i, length - i, out);
+		else
+#endif
+			asciiCount = CopyAsciiScalar(src + i, length - i, out);
+		i += asciiCount;
+		out += asciiCount;
 
-	// Load the PDB file
-	hr = pSource->loadDataFromPdb(argv[1]);
-	if (FAILED(hr)) {
-		std::wcerr << L"loadDataFromPdb failed" << std::endl;
-		CoUninitialize();
-		return 1;
-	}
+		// Encode up to the next ASCII code unit, then go back to the fast path
+		for (; i < length && static_cast<uint32_t>(src[i]) >= 0x80; i++) {
+			uint32_t codePoint = static_cast<uint32_t>(src[i]);
+			if (codePoint < 0x800) {
+				*out++ = static_cast<char>(0xC0 | (codePoint >> 6));
+				*out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+				continue;
+			}
 
-	CComPtr<IDiaSession> pSession;
-	hr = pSource->openSession(&pSession);
-	if (FAILED(hr)) {
-		std::wcerr << L"openSession failed" << std::endl;
-		CoUninitialize();
-		return 1;
-	}
+			if (codePoint >= 0xD800 && codePoint <= 0xDFFF) {
+				uint32_t next = i + 1 < length ? static_cast<uint32_t>(src[i + 1]) : 0;
+				if (codePoint <= 0xDBFF && next >= 0xDC00 && next <= 0xDFFF) {
+					codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (next - 0xDC00);
+					i++;
+				}
+				else {
+					codePoint = 0xFFFD;
+				}
+			}
+			else if (codePoint > 0x10FFFF) {
+				codePoint = 0xFFFD;
+			}
 
-	CComPtr<IDiaSymbol> pGlobal;
-	hr = pSession->get_globalScope(&pGlobal);
-	if (FAILED(hr)) {
-		std::wcerr << L"get_globalScope failed" << std::endl;
-		CoUninitialize();
-		return 1;
+			if (codePoint < 0x10000) {
+				*out++ = static_cast<char>(0xE0 | (codePoint >> 12));
+			}
+			else {
+				*out++ = static_cast<char>(0xF0 | (codePoint >> 18));
+				*out++ = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+			}
+			*out++ = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+			*out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
 	}
+	return out - dst;
+}
+
+std::string WStringToString(const wchar_t* wstr, size_t length) {
+	// Short strings are converted on the stack so that the result is allocated at its final size
+	char buffer[768];
+	if (length <= sizeof(buffer) / 3)
+		return std::string(buffer, TranscodeUtf16ToUtf8(wstr, length, buffer));
+
+	std::string strTo(length * 3, '\0');
+	strTo.resize(TranscodeUtf16ToUtf8(wstr, length, &strTo[0]));
+	strTo.shrink_to_fit();
+	return strTo;
+}
 
-	// Create JSON root object
-	json output;
+std::string WStringToString(const std::wstring& wstr) {
+	return WStringToString(wstr.data(), wstr.size());
+}
 
-	// Enumerate symbols
-	EnumerateSymbols(pGlobal, output, filePrefix);
+std::string WStringToString(const ScratchWString& wstr) {
+	return WStringToString(wstr.data(), wstr.size());
+}
 
-	// Output the JSON to a file
-	std::ofstream outFile("pdb_dump.json");
-	outFile << output.dump(2);
-	outFile.close();
+// Command-line switches that change what gets emitted
+// Top-level arrays that --kinds can select. A kind that is not selected is never enumerated
+// for; its array stays in the output, empty, so that consumers see the same layout.
+enum OutputKind : DWORD {
+	KindClasses = 1 << 0,
+	KindEnums = 1 << 1,
+	KindFunctions = 1 << 2,
+	KindGlobals = 1 << 3,
+	KindTypedefs = 1 << 4,
+	KindAll = (1 << 5) - 1,
+};
 
-	// Reset console title
-	SetConsoleTitle(L"DumpPDB - Complete");
+// Record keys that --fields can select, at every nesting level: "Name" covers classes, fields,
+// methods and enum values alike. A field that is not selected is not looked up at all.
+enum OutputField : DWORD {
+	FieldName = 1 << 0,
+	FieldSize = 1 << 1,
+	FieldSourceFile = 1 << 2,
+	FieldLineNumber = 1 << 3,
+	FieldBaseClasses = 1 << 4,
+	FieldFields = 1 << 5,
+	FieldMethods = 1 << 6,
+	FieldFlattenedLayout = 1 << 7,
+	FieldIsVirtual = 1 << 8,
+	FieldIsPureVirtual = 1 << 9,
+	FieldIsStatic = 1 << 10,
+	FieldIsConst = 1 << 11,
+	FieldOffset = 1 << 12,
+	FieldType = 1 << 13,
+	FieldBitPosition = 1 << 14,
+	FieldBitWidth = 1 << 15,
+	FieldVirtualOffset = 1 << 16,
+	FieldVirtualMethodIndex = 1 << 17,
+	FieldVirtualTableOffset = 1 << 18,
+	FieldParameters = 1 << 19,
+	FieldUnderlyingType = 1 << 20,
+	FieldValues = 1 << 21,
+	FieldValue = 1 << 22,
+	FieldAll = (1 << 23) - 1,
+};
 
-	std::wcout << L"PDB information has been dumped to pdb_dump.json" << std::endl;
+struct DumpOptions {
+	bool emitTypeDescriptors = false; // --type-descriptors: add "TypeId" references and a "Types" table
+	bool templateAliases = false;     // --template-aliases: spell well-known templates as std::string, std::vector<T>, ...
+	bool flattenLayout = false;       // --flatten-layout: add each class's complete layout including inherited members
+	ULONG enumerationBatchSize = 64;  // --batch-size N: symbols fetched per IDiaEnumSymbols::Next call
+	unsigned threadCount = 0;         // --threads N: extraction worker threads, 0 = GetDefaultThreadCount()
+	std::wstring batchSource;         // --batch LIST|DIR: dump every PDB named in a list file or found in a directory
+	std::wstring outputDirectory;     // --output-dir DIR: where dumps are written
+	unsigned maxOpenPdbs = 2;         // --max-open N: PDBs extracted at the same time in batch mode
+	ULONGLONG memoryBudget = 0;       // --memory-budget MB: spooled enums, functions, variables and typedefs kept in memory per PDB, 0 = no limit
+	std::wstring benchmarkName;       // --benchmark NAME: time an internal stage instead of dumping
+	DWORD kinds = KindAll;            // --kinds LIST: OutputKind bits of the arrays to extract
+	DWORD fields = FieldAll;          // --fields LIST: OutputField bits of the keys to extract
+	std::vector<std::wstring> rootNames; // --root NAME, --roots-file FILE: extract only the types reachable from these
+	bool dedupClasses = true;         // --keep-duplicates clears it: emit every copy of a class
+	std::wstring cacheDirectory;      // --cache DIR: serve dumps of already seen PDBs from DIR
+	ULONGLONG cacheLimit = 0;         // --cache-limit MB: evict least recently used dumps beyond MB, 0 = no limit
+	bool cacheStats = false;          // --cache-stats: print what the cache holds and exit
+	std::wstring incrementalBase;     // --incremental PREV: reuse unchanged records of the dump PREV (batch mode: directory of dumps)
+	std::wstring diffOldPath;         // --diff OLD NEW: compare the classes and enums of two dumps or PDBs instead of dumping
+	std::wstring diffNewPath;
+	bool writeDatabase = false;       // --database: also write <dump>.pdbdb, the binary database PDBDatabase.h reads (held in memory, outside --memory-budget)
+	std::wstring symbolizeDatabase;   // --symbolize DB: look addresses up in a --database file instead of dumping
+	bool printStats = false;          // --stats: print string pool and template name statistics after dumping
+};
+DumpOptions dumpOptions;
 
-	CoUninitialize();
-	return 0;
+// Every worker opens its own DIA session, which for a large PDB holds hundreds of megabytes of
+// symbol and type data, so without --threads only up to 8 workers are used
+const unsigned MaxDefaultThreads = 8;
+
+unsigned GetDefaultThreadCount() {
+	if (dumpOptions.threadCount != 0)
+		return dumpOptions.threadCount;
+	return (std::min)(MaxDefaultThreads, (std::max)(1u, std::thread::hardware_concurrency()));
 }
 
-void EnumerateSymbols(CComPtr<IDiaSymbol> pGlobal, json& output, const std::wstring& filePrefix) {
-	HRESULT hr;
-	CComPtr<IDiaEnumSymbols> pEnumSymbols;
+// Whether any of the OutputField bits in `mask` was asked for
+inline bool EmitField(DWORD mask) {
+	return (dumpOptions.fields & mask) != 0;
+}
 
-	// Prepare JSON arrays
-	json classesArray = json::array();
-	json enumsArray = json::array();
-	json globalsArray = json::array();
-	json functionsArray = json::array();
-	json typedefsArray = json::array();
+const std::pair<const wchar_t*, DWORD> outputKindNames[] = {
+	{ L"Classes", KindClasses },
+	{ L"Enums", KindEnums },
+	{ L"GlobalFunctions", KindFunctions },
+	{ L"GlobalVariables", KindGlobals },
+	{ L"Typedefs", KindTypedefs },
+};
 
-	// Enumerate all symbols
-	hr = pGlobal->findChildren(SymTagNull, NULL, nsNone, &pEnumSymbols);
-	if (FAILED(hr)) {
-		std::wcerr << L"findChildren failed" << std::endl;
-		return;
+const std::pair<const wchar_t*, DWORD> outputFieldNames[] = {
+	{ L"Name", FieldName },
+	{ L"Size", FieldSize },
+	{ L"SourceFile", FieldSourceFile },
+	{ L"LineNumber", FieldLineNumber },
+	{ L"BaseClasses", FieldBaseClasses },
+	{ L"Fields", FieldFields },
+	{ L"Methods", FieldMethods },
+	{ L"FlattenedLayout", FieldFlattenedLayout },
+	{ L"IsVirtual", FieldIsVirtual },
+	{ L"IsPureVirtual", FieldIsPureVirtual },
+	{ L"IsStatic", FieldIsStatic },
+	{ L"IsConst", FieldIsConst },
+	{ L"Offset", FieldOffset },
+	{ L"Type", FieldType },
+	{ L"BitPosition", FieldBitPosition },
+	{ L"BitWidth", FieldBitWidth },
+	{ L"VirtualOffset", FieldVirtualOffset },
+	{ L"VirtualMethodIndex", FieldVirtualMethodIndex },
+	{ L"VirtualTableOffset", FieldVirtualTableOffset },
+	{ L"Parameters", FieldParameters },
+	{ L"UnderlyingType", FieldUnderlyingType },
+	{ L"Values", FieldValues },
+	{ L"Value", FieldValue },
+};
+
+// Parses a comma-separated list of names from `table` into a bit mask. Returns false and
+// reports the first unknown name.
+template <size_t N>
+bool ParseProjection(const std::wstring& list, const std::pair<const wchar_t*, DWORD> (&table)[N], DWORD& mask) {
+	mask = 0;
+	size_t begin = 0;
+	while (begin <= list.size()) {
+		size_t end = list.find(L',', begin);
+		if (end == std::wstring::npos)
+			end = list.size();
+		std::wstring name = list.substr(begin, end - begin);
+		if (!name.empty()) {
+			const std::pair<const wchar_t*, DWORD>* entry = std::find_if(table, table + N,
+				[&](const std::pair<const wchar_t*, DWORD>& candidate) { return name == candidate.first; });
+			if (entry == table + N) {
+				std::wcerr << L"Unknown name " << name << L" in " << list << std::endl;
+				return false;
+			}
+			mask |= entry->second;
+		}
+		begin = end + 1;
 	}
+	return true;
+}
 
-	LONG totalSymbols = 0;
-	pEnumSymbols->get_Count(&totalSymbols);
+// The SymTag to enumerate the global scope for: with a single kind selected DIA only hands out
+// those symbols, otherwise everything is enumerated and ProcessSymbol picks
+enum SymTagEnum GetEnumerationTag() {
+	switch (dumpOptions.kinds) {
+	case KindClasses: return SymTagUDT;
+	case KindEnums: return SymTagEnum;
+	case KindFunctions: return SymTagFunction;
+	case KindGlobals: return SymTagData;
+	case KindTypedefs: return SymTagTypedef;
+	default: return SymTagNull;
+	}
+}
 
-	CComPtr<IDiaSymbol> pSymbol;
-	ULONG celt = 0;
-	LONG processedSymbols = 0;
-	double lastProgressPercentage = -1.0; // Initialize to -1 to ensure the first update
+// Reusable fetch buffers for ForEachSymbol, one per nesting level (members inside classes inside the
+// global scope), so that steady-state enumeration doesn't allocate. A deque keeps outer buffers in
+// place while inner levels are added.
+struct SymbolBatchBuffers {
+	std::deque<std::vector<IDiaSymbol*>> levels;
+	size_t depth = 0;
+};
+thread_local SymbolBatchBuffers symbolBatchBuffers;
+
+// Per-thread bump allocator for data that only lives while one top-level symbol is processed.
+// Allocations are carved out of a block that is reused for every symbol; only symbols that
+// outgrow it touch the heap, and Reset hands all of that back at once. Disabled, it forwards to
+// the heap so that the two can be compared (--benchmark arena).
+class ScratchArena {
+public:
+	static const size_t BlockSize = 64 * 1024;
 
-	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && celt == 1) {
-		DWORD symTag = 0;
-		pSymbol->get_symTag(&symTag);
+	ScratchArena() : block(new char[BlockSize]), resource(block.get(), BlockSize) {}
 
-		// Update progress
-		processedSymbols++;
+	std::pmr::memory_resource* GetResource() {
+		static HeapResource heap;
+		return enabled ? static_cast<std::pmr::memory_resource*>(&resource) : &heap;
+	}
+
+	// Everything allocated since the last reset must have been destroyed
+	void Reset() { resource.release(); }
+
+	static bool enabled;
+
+private:
+	// Plain operator new/delete, as std::string would use
+	class HeapResource : public std::pmr::memory_resource {
+		void* do_allocate(size_t bytes, size_t) override { return ::operator new(bytes); }
+		void do_deallocate(void* p, size_t, size_t) override { ::operator delete(p); }
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+	};
 
-		double progressPercentage = (static_cast<double>(processedSymbols) * 100.0) / static_cast<double>(totalSymbols);
-		// Round to one decimal place
-		progressPercentage = floor(progressPercentage * 10.0 + 0.5) / 10.0;
+	std::unique_ptr<char[]> block;
+	std::pmr::monotonic_buffer_resource resource;
+};
+bool ScratchArena::enabled = true;
+thread_local ScratchArena scratchArena;
 
-		// Only update the title if the percentage has changed
-		if (progressPercentage != lastProgressPercentage) {
-			lastProgressPercentage = progressPercentage;
-			std::wstringstream titleStream;
-			titleStream << L"DumpPDB - Processing (" << std::fixed << std::setprecision(1) << progressPercentage << L"%)";
-			SetConsoleTitle(titleStream.str().c_str());
+// Calls `callback` for every symbol of an enumerator (or the next `maxSymbols` of them), fetching up to
+// `batchSize` symbols per Next() call instead of one at a time. The callback borrows the symbol; it is
+// released after the call.
+template <typename Callback>
+void ForEachSymbol(IDiaEnumSymbols* pEnumSymbols, Callback&& callback, ULONG batchSize = dumpOptions.enumerationBatchSize, ULONG maxSymbols = ULONG_MAX) {
+	if (batchSize == 0)
+		batchSize = 1;
+
+	if (symbolBatchBuffers.levels.size() <= symbolBatchBuffers.depth)
+		symbolBatchBuffers.levels.emplace_back();
+	std::vector<IDiaSymbol*>& buffer = symbolBatchBuffers.levels[symbolBatchBuffers.depth];
+	if (buffer.size() < batchSize)
+		buffer.resize(batchSize);
+
+	// Releases whatever the callback didn't get to if it throws, and pops the nesting level
+	struct BatchScope {
+		std::vector<IDiaSymbol*>& buffer;
+		ULONG next = 0;
+		ULONG fetched = 0;
+		~BatchScope() {
+			for (; next < fetched; next++)
+				buffer[next]->Release();
+			symbolBatchBuffers.depth--;
 		}
+	} scope{ buffer };
+	symbolBatchBuffers.depth++;
 
-		switch (symTag) {
-		case SymTagUDT:
-			ProcessUDT(pSymbol, classesArray, filePrefix, totalSymbols, processedSymbols, lastProgressPercentage);
-			break;
-		case SymTagEnum:
-			ProcessEnum(pSymbol, enumsArray, filePrefix, totalSymbols, processedSymbols, lastProgressPercentage);
-			break;
-		case SymTagFunction:
-			ProcessFunction(pSymbol, functionsArray, filePrefix, totalSymbols, processedSymbols, lastProgressPercentage);
-			break;
-		case SymTagData:
-			ProcessData(pSymbol, globalsArray, filePrefix, totalSymbols, processedSymbols, lastProgressPercentage);
-			break;
-		case SymTagTypedef:
-			ProcessTypedef(pSymbol, typedefsArray, totalSymbols, processedSymbols, lastProgressPercentage);
-			break;
-		default:
+	while (maxSymbols > 0) {
+		ULONG requested = (std::min)(batchSize, maxSymbols);
+		if (FAILED(pEnumSymbols->Next(requested, buffer.data(), &scope.fetched)) || scope.fetched == 0)
 			break;
+		maxSymbols -= scope.fetched;
+		for (scope.next = 0; scope.next < scope.fetched; scope.next++) {
+			callback(buffer[scope.next]);
+			buffer[scope.next]->Release();
 		}
-
-		pSymbol.Release();
+		if (scope.fetched < requested)
+			break;
+		scope.fetched = 0;
 	}
-
-	output["Classes"] = classesArray;
-	output["Enums"] = enumsArray;
-	output["GlobalFunctions"] = functionsArray;
-	output["GlobalVariables"] = globalsArray;
-	output["Typedefs"] = typedefsArray;
 }
 
-void ProcessUDT(CComPtr<IDiaSymbol> pSymbol, json& classesArray, const std::wstring& filePrefix, LONG totalSymbols, LONG& processedSymbols, double& lastProgressPercentage) {
-	HRESULT hr;
-
-	json classObject;
+// A string from the process-wide StringPool: its UTF-16 and UTF-8 spellings and an ID that is
+// equal for equal strings. The views stay valid until the process exits.
+struct InternedString {
+	DWORD id = 0;             // 0 is the empty string
+	std::wstring_view wide;
+	std::string_view utf8;
+};
 
-	// Get class name
-	std::wstring className = GetSymbolName(pSymbol);
-	classObject["Name"] = WStringToString(className);
+// Pool of the distinct strings of one PDB. Names, type names and file names repeat across symbols
+// and sessions; each distinct spelling is stored and converted to UTF-8 once. The pool is split
+// into shards with their own lock so that extraction threads rarely contend.
+class StringPool {
+public:
+	InternedString Intern(std::wstring_view text) {
+		if (text.empty())
+			return InternedString();
 
-	// Get class size
-	ULONGLONG length = 0;
-	pSymbol->get_length(&length);
-	classObject["Size"] = length;
-
-	// Get class definition file and line number
-	std::wstring fileName = GetSymbolFileName(pSymbol);
-	if (!fileName.empty()) {
-		// Apply file prefix filter
-		if (!filePrefix.empty()) {
-			if (fileName.find(filePrefix) != 0) {
-				// The file name does not start with the prefix, skip this class
-				return;
-			}
+		size_t hash = std::hash<std::wstring_view>()(text);
+		size_t shardIndex = hash % ShardCount;
+		Shard& shard = shards[shardIndex];
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		auto it = shard.ids.find(text);
+		if (it != shard.ids.end()) {
+			const InternedString& interned = shard.strings[it->second];
+			shard.useCount++;
+			shard.usedBytes += interned.utf8.size();
+			return interned;
 		}
-		classObject["SourceFile"] = WStringToString(fileName);
-	}
 
-	DWORD lineNumber = GetSymbolLineNumber(pSymbol);
-	if (lineNumber != 0)
-		classObject["LineNumber"] = lineNumber;
+		shard.wideTexts.emplace_back(text);
+		shard.utf8Texts.push_back(WStringToString(text.data(), text.size()));
 
-	// Base classes
-	json baseClassesArray = json::array();
-	CComPtr<IDiaEnumSymbols> pBaseClasses;
-	hr = pSymbol->findChildren(SymTagBaseClass, NULL, nsNone, &pBaseClasses);
-	if (SUCCEEDED(hr)) {
-		CComPtr<IDiaSymbol> pBaseClass;
-		ULONG celt = 0;
-		while (SUCCEEDED(pBaseClasses->Next(1, &pBaseClass, &celt)) && celt == 1) {
-			json baseClassObject;
-			std::wstring baseClassName = GetSymbolName(pBaseClass);
-			baseClassObject["Name"] = WStringToString(baseClassName);
-
-			// Is virtual base class
-			BOOL isVirtual = FALSE;
-			pBaseClass->get_virtualBaseClass(&isVirtual);
-			baseClassObject["IsVirtual"] = isVirtual ? true : false;
+		InternedString interned;
+		interned.id = static_cast<DWORD>(((shard.strings.size() + 1) * ShardCount) | shardIndex);
+		interned.wide = shard.wideTexts.back();
+		interned.utf8 = shard.utf8Texts.back();
+		shard.ids.emplace(interned.wide, shard.strings.size());
+		shard.strings.push_back(interned);
 
-			// Offset
-			LONG offset = 0;
-			pBaseClass->get_offset(&offset);
-			baseClassObject["Offset"] = offset;
+		shard.useCount++;
+		shard.usedBytes += interned.utf8.size();
+		shard.storedBytes += interned.wide.size() * sizeof(wchar_t) + interned.utf8.size();
+		return interned;
+	}
 
-			baseClassesArray.push_back(baseClassObject);
-			pBaseClass.Release();
+	// Totals over all shards: distinct strings, lookups, UTF-8 bytes the lookups asked for and
+	// bytes actually stored (both spellings)
+	void GetStats(size_t& distinctCount, ULONGLONG& useCount, ULONGLONG& usedBytes, ULONGLONG& storedBytes) {
+		distinctCount = 0;
+		useCount = usedBytes = storedBytes = 0;
+		for (Shard& shard : shards) {
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			distinctCount += shard.strings.size();
+			useCount += shard.useCount;
+			usedBytes += shard.usedBytes;
+			storedBytes += shard.storedBytes;
 		}
 	}
-	classObject["BaseClasses"] = baseClassesArray;
-
-	// Data members (fields)
-	json fieldsArray = json::array();
-	CComPtr<IDiaEnumSymbols> pDataMembers;
-	hr = pSymbol->findChildren(SymTagData, NULL, nsNone, &pDataMembers);
-	if (SUCCEEDED(hr)) {
-		CComPtr<IDiaSymbol> pDataMember;
-		ULONG celt = 0;
-		while (SUCCEEDED(pDataMembers->Next(1, &pDataMember, &celt)) && celt == 1) {
-			json fieldObject;
-			std::wstring fieldName = GetSymbolName(pDataMember);
-			fieldObject["Name"] = WStringToString(fieldName);
-
-			// Type
-			CComPtr<IDiaSymbol> pType;
-			pDataMember->get_type(&pType);
-			std::wstring typeName = GetTypeName(pType);
-			fieldObject["Type"] = WStringToString(typeName);
 
-			// Is static
-			DWORD locationType = 0;
-			pDataMember->get_locationType(&locationType);
-			bool isStatic = (locationType == LocIsStatic);
-			fieldObject["IsStatic"] = isStatic;
+private:
+	static const size_t ShardCount = 64;
 
-			// Is const
-			BOOL isConst = FALSE;
-			pDataMember->get_constType(&isConst);
-			fieldObject["IsConst"] = isConst ? true : false;
+	struct Shard {
+		std::mutex mutex;
+		std::deque<std::wstring> wideTexts; // Deques never move their elements, so views stay valid
+		std::deque<std::string> utf8Texts;
+		std::vector<InternedString> strings;
+		std::unordered_map<std::wstring_view, size_t> ids;
+		ULONGLONG useCount = 0;
+		ULONGLONG usedBytes = 0;
+		ULONGLONG storedBytes = 0;
+	};
+	Shard shards[ShardCount];
+};
 
-			// Offset
-			LONG offset = 0;
-			pDataMember->get_offset(&offset);
-			fieldObject["Offset"] = offset;
+// Name rules compiled into one Thompson NFA. Globs (* and ?), regular expressions (re:) and
+// namespace scopes (ns:) all become NFA fragments whose accepting state records whether the rule
+// includes or excludes, so every rule is tested in a single pass over the name.
+class NameAutomaton {
+public:
+	enum StateKind {
+		StateChar,    // consumes c
+		StateAny,     // consumes any character
+		StateClass,   // consumes a character in classes[classIndex]
+		StateSplit,   // epsilon to next and, if set, alt
+		StateAccept,
+	};
+	struct State {
+		StateKind kind = StateSplit;
+		wchar_t c = 0;
+		size_t classIndex = 0;
+		size_t next = NoState;
+		size_t alt = NoState;
+		bool exclude = false;
+	};
+	struct CharClass {
+		std::vector<std::pair<wchar_t, wchar_t>> ranges;
+		bool negated = false;
 
-			// Virtual Offset
-			uintptr_t virtualAddress = 0;
-			pDataMember->get_virtualAddress((ULONGLONG*)&virtualAddress);
-			fieldObject["VirtualOffset"] = virtualAddress;
+		bool Contains(wchar_t c) const {
+			bool found = false;
+			for (const auto& range : ranges)
+				found = found || (c >= range.first && c <= range.second);
+			return found != negated;
+		}
+	};
+	static constexpr size_t NoState = SIZE_MAX;
 
-			fieldsArray.push_back(fieldObject);
-			pDataMember.Release();
+	// Adds "re:REGEX", "ns:Namespace::Scope" or a glob. Regular expressions support literals, .,
+	// [classes], \d \w \s, grouping, |, *, + and ?, and like globs must match the whole name.
+	bool AddRule(const std::wstring& pattern, bool exclude, std::wstring& error) {
+		Fragment fragment;
+		if (HasRuleKind(pattern, L"re:")) {
+			RegexParser parser{ *this, pattern, 3 };
+			if (!parser.ParseAlternation(fragment) || parser.pos != pattern.size()) {
+				error = L"invalid regular expression at offset " + std::to_wstring(parser.pos - 3);
+				return false;
+			}
+		}
+		else if (HasRuleKind(pattern, L"ns:")) {
+			std::wstring scope = pattern.substr(3);
+			if (scope.size() < 2 || scope.compare(scope.size() - 2, 2, L"::") != 0)
+				scope += L"::";
+			fragment = Literal(scope);
+			fragment = Concat(fragment, Star(Single(StateAny)));
+		}
+		else {
+			fragment = Empty();
+			for (wchar_t c : pattern) {
+				if (c == L'*')
+					fragment = Concat(fragment, Star(Single(StateAny)));
+				else if (c == L'?')
+					fragment = Concat(fragment, Single(StateAny));
+				else
+					fragment = Concat(fragment, Single(StateChar, c));
+			}
 		}
-	}
-	classObject["Fields"] = fieldsArray;
 
-	// Methods
-	json methodsArray = json::array();
-	CComPtr<IDiaEnumSymbols> pFunctions;
-	hr = pSymbol->findChildren(SymTagFunction, NULL, nsNone, &pFunctions);
-	if (SUCCEEDED(hr)) {
-		CComPtr<IDiaSymbol> pFunction;
-		ULONG celt = 0;
-		int virtualMethodIndex = 0;
-		while (SUCCEEDED(pFunctions->Next(1, &pFunction, &celt)) && celt == 1) {
-			json methodObject;
-			std::wstring methodName = GetSymbolName(pFunction);
-			methodObject["Name"] = WStringToString(methodName);
-
-			// Is virtual
-			BOOL isVirtual = FALSE;
-			pFunction->get_virtual(&isVirtual);
-			methodObject["IsVirtual"] = isVirtual ? true : false;
+		size_t accept = AddState(StateAccept);
+		states[accept].exclude = exclude;
+		states[fragment.end].next = accept;
+		starts.push_back(fragment.start);
+		if (!exclude)
+			hasIncludes = true;
+		return true;
+	}
 
-			// Is pure virtual
-			BOOL isPureVirtual = FALSE;
-			pFunction->get_pure(&isPureVirtual);
-			methodObject["IsPureVirtual"] = isPureVirtual ? true : false;
+	bool IsEmpty() const {
+		return starts.empty();
+	}
 
-			// Is static
-			BOOL isStatic = FALSE;
-			pFunction->get_isStatic(&isStatic);
-			methodObject["IsStatic"] = isStatic ? true : false;
+	bool HasIncludes() const {
+		return hasIncludes;
+	}
 
-			// Is const
-			BOOL isConst = FALSE;
-			pFunction->get_constType(&isConst);
-			methodObject["IsConst"] = isConst ? true : false;
+	const std::vector<State>& GetStates() const {
+		return states;
+	}
 
-			// Virtual method index (approximate)
-			if (isVirtual)
-				methodObject["VirtualMethodIndex"] = virtualMethodIndex++;
-
-			// Virtual Offset
-			uintptr_t virtualAddress = 0;
-			pFunction->get_virtualAddress((ULONGLONG*)&virtualAddress);
-			methodObject["VirtualOffset"] = virtualAddress;
-
-			// Parameters
-			json paramsArray = json::array();
-			CComPtr<IDiaEnumSymbols> pParams;
-			hr = pFunction->findChildren(SymTagFunctionArgType, NULL, nsNone, &pParams);
-			if (SUCCEEDED(hr)) {
-				CComPtr<IDiaSymbol> pParam;
-				ULONG celtParam = 0;
-				while (SUCCEEDED(pParams->Next(1, &pParam, &celtParam)) && celtParam == 1) {
-					json paramObject;
-
-					// Parameter type
-					CComPtr<IDiaSymbol> pType;
-					pParam->get_type(&pType);
-					std::wstring paramTypeName = GetTypeName(pType);
-					paramObject["Type"] = WStringToString(paramTypeName);
+	const std::vector<CharClass>& GetClasses() const {
+		return classes;
+	}
 
-					paramsArray.push_back(paramObject);
-					pParam.Release();
-				}
-			}
-			methodObject["Parameters"] = paramsArray;
+	const std::vector<size_t>& GetStarts() const {
+		return starts;
+	}
 
-			methodsArray.push_back(methodObject);
-			pFunction.Release();
-		}
+private:
+	// "ns::Name" is a glob for a namespace called ns, not a namespace rule for ":Name"
+	static bool HasRuleKind(const std::wstring& pattern, const wchar_t* kind) {
+		return pattern.compare(0, 3, kind) == 0 && (pattern.size() == 3 || pattern[3] != L':');
 	}
-	classObject["Methods"] = methodsArray;
 
-	classesArray.push_back(classObject);
-}
+	// A piece of NFA entered at start and left through end, a split state whose next is unset
+	struct Fragment {
+		size_t start = NoState;
+		size_t end = NoState;
+	};
 
-void ProcessEnum(CComPtr<IDiaSymbol> pSymbol, json& enumsArray, const std::wstring& filePrefix, LONG totalSymbols, LONG& processedSymbols, double& lastProgressPercentage) {
-	json enumObject;
+	struct RegexParser {
+		NameAutomaton& automaton;
+		const std::wstring& pattern;
+		size_t pos;
 
-	// Get enum name
-	std::wstring enumName = GetSymbolName(pSymbol);
-	enumObject["Name"] = WStringToString(enumName);
+		bool AtEnd() const {
+			return pos == pattern.size();
+		}
 
-	// Underlying type
-	CComPtr<IDiaSymbol> pType;
-	pSymbol->get_type(&pType);
-	std::wstring underlyingTypeName = GetTypeName(pType);
-	enumObject["UnderlyingType"] = WStringToString(underlyingTypeName);
-
-	// Get enum definition file and line number
-	std::wstring fileName = GetSymbolFileName(pSymbol);
-	if (!fileName.empty()) {
-		// Apply file prefix filter
-		if (!filePrefix.empty()) {
-			if (fileName.find(filePrefix) != 0) {
-				// The file name does not start with the prefix, skip this enum
-				return;
+		bool ParseAlternation(Fragment& result) {
+			if (!ParseSequence(result))
+				return false;
+			while (!AtEnd() && pattern[pos] == L'|') {
+				pos++;
+				Fragment right;
+				if (!ParseSequence(right))
+					return false;
+				result = automaton.Alternate(result, right);
 			}
+			return true;
 		}
-		enumObject["SourceFile"] = WStringToString(fileName);
-	}
 
-	DWORD lineNumber = GetSymbolLineNumber(pSymbol);
-	if (lineNumber != 0)
-		enumObject["LineNumber"] = lineNumber;
+		bool ParseSequence(Fragment& result) {
+			result = automaton.Empty();
+			while (!AtEnd() && pattern[pos] != L'|' && pattern[pos] != L')') {
+				Fragment atom;
+				if (!ParseAtom(atom))
+					return false;
+				while (!AtEnd() && (pattern[pos] == L'*' || pattern[pos] == L'+' || pattern[pos] == L'?')) {
+					wchar_t op = pattern[pos++];
+					atom = op == L'*' ? automaton.Star(atom) : op == L'+' ? automaton.Plus(atom) : automaton.Optional(atom);
+					// A lazy quantifier matches the same whole names
+					if (!AtEnd() && pattern[pos] == L'?')
+						pos++;
+				}
+				result = automaton.Concat(result, atom);
+			}
+			return true;
+		}
 
-	// Enum values
-	json valuesArray = json::array();
-	CComPtr<IDiaEnumSymbols> pEnumValues;
-	HRESULT hr = pSymbol->findChildren(SymTagData, NULL, nsNone, &pEnumValues);
-	if (SUCCEEDED(hr)) {
-		CComPtr<IDiaSymbol> pEnumValue;
-		ULONG celt = 0;
-		while (SUCCEEDED(pEnumValues->Next(1, &pEnumValue, &celt)) && celt == 1) {
-			json valueObject;
-			std::wstring valueName = GetSymbolName(pEnumValue);
-			valueObject["Name"] = WStringToString(valueName);
+		bool ParseAtom(Fragment& result) {
+			wchar_t c = pattern[pos++];
+			switch (c) {
+			case L'(':
+				if (!ParseAlternation(result) || AtEnd() || pattern[pos] != L')')
+					return false;
+				pos++;
+				return true;
+			case L'.':
+				result = automaton.Single(StateAny);
+				return true;
+			case L'[':
+				return ParseClass(result);
+			case L'\\':
+				if (AtEnd())
+					return false;
+				c = pattern[pos++];
+				if (c == L'd' || c == L'w' || c == L's') {
+					CharClass charClass;
+					AddEscapeRanges(c, charClass);
+					result = automaton.Class(std::move(charClass));
+				}
+				else {
+					result = automaton.Single(StateChar, c);
+				}
+				return true;
+			case L'*':
+			case L'+':
+			case L'?':
+				pos--;
+				return false;
+			default:
+				result = automaton.Single(StateChar, c);
+				return true;
+			}
+		}
 
-			// Value
-			VARIANT value;
-			VariantInit(&value);
-			pEnumValue->get_value(&value);
-			if (value.vt == VT_INT) {
-				valueObject["Value"] = value.intVal;
+		bool ParseClass(Fragment& result) {
+			CharClass charClass;
+			if (!AtEnd() && pattern[pos] == L'^') {
+				charClass.negated = true;
+				pos++;
 			}
-			else if (value.vt == VT_UI4) {
-				valueObject["Value"] = value.uintVal;
+			bool first = true;
+			while (!AtEnd() && (pattern[pos] != L']' || first)) {
+				first = false;
+				wchar_t low = pattern[pos++];
+				if (low == L'\\') {
+					if (AtEnd())
+						return false;
+					low = pattern[pos++];
+					if (low == L'd' || low == L'w' || low == L's') {
+						AddEscapeRanges(low, charClass);
+						continue;
+					}
+				}
+				wchar_t high = low;
+				if (pos + 1 < pattern.size() && pattern[pos] == L'-' && pattern[pos + 1] != L']') {
+					high = pattern[pos + 1];
+					pos += 2;
+					if (high < low)
+						return false;
+				}
+				charClass.ranges.push_back({ low, high });
 			}
-			else if (value.vt == VT_I8) {
-				valueObject["Value"] = value.llVal;
+			if (AtEnd())
+				return false;
+			pos++;
+			result = automaton.Class(std::move(charClass));
+			return true;
+		}
+
+		static void AddEscapeRanges(wchar_t escape, CharClass& charClass) {
+			if (escape == L'd') {
+				charClass.ranges.push_back({ L'0', L'9' });
 			}
-			else if (value.vt == VT_UI8) {
-				valueObject["Value"] = value.ullVal;
+			else if (escape == L'w') {
+				charClass.ranges.push_back({ L'a', L'z' });
+				charClass.ranges.push_back({ L'A', L'Z' });
+				charClass.ranges.push_back({ L'0', L'9' });
+				charClass.ranges.push_back({ L'_', L'_' });
 			}
 			else {
-				valueObject["Value"] = nullptr;
+				charClass.ranges.push_back({ L' ', L' ' });
+				charClass.ranges.push_back({ L'\t', L'\r' });
 			}
-			VariantClear(&value);
-
-			valuesArray.push_back(valueObject);
-			pEnumValue.Release();
 		}
+	};
+
+	size_t AddState(StateKind kind) {
+		states.emplace_back();
+		states.back().kind = kind;
+		return states.size() - 1;
 	}
-	enumObject["Values"] = valuesArray;
 
-	enumsArray.push_back(enumObject);
-}
+	Fragment Empty() {
+		size_t state = AddState(StateSplit);
+		return { state, state };
+	}
 
-void ProcessTypedef(CComPtr<IDiaSymbol> pSymbol, json& typedefsArray, LONG totalSymbols, LONG& processedSymbols, double& lastProgressPercentage) {
-	json typedefObject;
+	Fragment Single(StateKind kind, wchar_t c = 0) {
+		size_t state = AddState(kind);
+		size_t end = AddState(StateSplit);
+		states[state].c = c;
+		states[state].next = end;
+		return { state, end };
+	}
 
-	// Get typedef name
-	std::wstring typedefName = GetSymbolName(pSymbol);
-	typedefObject["Name"] = WStringToString(typedefName);
+	Fragment Class(CharClass&& charClass) {
+		classes.push_back(std::move(charClass));
+		Fragment fragment = Single(StateClass);
+		states[fragment.start].classIndex = classes.size() - 1;
+		return fragment;
+	}
 
-	// Underlying type
-	CComPtr<IDiaSymbol> pType;
-	pSymbol->get_type(&pType);
-	std::wstring underlyingTypeName = GetTypeName(pType);
-	typedefObject["UnderlyingType"] = WStringToString(underlyingTypeName);
+	Fragment Literal(const std::wstring& text) {
+		Fragment fragment = Empty();
+		for (wchar_t c : text)
+			fragment = Concat(fragment, Single(StateChar, c));
+		return fragment;
+	}
 
-	typedefsArray.push_back(typedefObject);
-}
+	Fragment Concat(Fragment first, Fragment second) {
+		states[first.end].next = second.start;
+		return { first.start, second.end };
+	}
 
-void ProcessFunction(CComPtr<IDiaSymbol> pSymbol, json& functionsArray, const std::wstring& filePrefix, LONG totalSymbols, LONG& processedSymbols, double& lastProgressPercentage) {
-	json functionObject;
+	Fragment Alternate(Fragment first, Fragment second) {
+		size_t start = AddState(StateSplit);
+		size_t end = AddState(StateSplit);
+		states[start].next = first.start;
+		states[start].alt = second.start;
+		states[first.end].next = end;
+		states[second.end].next = end;
+		return { start, end };
+	}
 
-	// Get function name
-	std::wstring functionName = GetSymbolName(pSymbol);
-	functionObject["Name"] = WStringToString(functionName);
+	Fragment Star(Fragment body) {
+		size_t loop = AddState(StateSplit);
+		size_t end = AddState(StateSplit);
+		states[loop].next = body.start;
+		states[loop].alt = end;
+		states[body.end].next = loop;
+		return { loop, end };
+	}
 
-	// Is static
-	BOOL isStatic = FALSE;
-	pSymbol->get_isStatic(&isStatic);
-	functionObject["IsStatic"] = isStatic ? true : false;
+	Fragment Plus(Fragment body) {
+		size_t loop = AddState(StateSplit);
+		size_t end = AddState(StateSplit);
+		states[loop].next = body.start;
+		states[loop].alt = end;
+		states[body.end].next = loop;
+		return { body.start, end };
+	}
 
-	// Is const
-	BOOL isConst = FALSE;
-	pSymbol->get_constType(&isConst);
-	functionObject["IsConst"] = isConst ? true : false;
-
-	// Get function definition file and line number
-	std::wstring fileName = GetSymbolFileName(pSymbol);
-	if (!fileName.empty()) {
-		// Apply file prefix filter
-		if (!filePrefix.empty()) {
-			if (fileName.find(filePrefix) != 0) {
-				// The file name does not start with the prefix, skip this function
-				return;
-			}
+	Fragment Optional(Fragment body) {
+		size_t start = AddState(StateSplit);
+		size_t end = AddState(StateSplit);
+		states[start].next = body.start;
+		states[start].alt = end;
+		states[body.end].next = end;
+		return { start, end };
+	}
+
+	std::vector<State> states;
+	std::vector<CharClass> classes;
+	std::vector<size_t> starts;
+	bool hasIncludes = false;
+};
+
+// DFA for a NameAutomaton, built lazily: each DFA state is a set of NFA states and its transitions
+// are computed the first time a name takes them. Names share long namespace prefixes, so after a
+// few names almost every step is a table lookup. Kept per session like the other caches, so it
+// needs no locking; it is flushed if it grows past MaxStates.
+class NameDfa {
+public:
+	// True if the name matches an include rule (or there are none) and no exclude rule
+	bool Passes(const NameAutomaton& automaton, std::wstring_view name) {
+		if (source != &automaton) {
+			source = &automaton;
+			Flush();
+		}
+
+		size_t state = startState;
+		for (wchar_t c : name) {
+			state = Step(state, c);
+			if (state == deadState)
+				break;
 		}
-		functionObject["SourceFile"] = WStringToString(fileName);
+		const DfaState& final = states[state];
+		return (final.include || !automaton.HasIncludes()) && !final.exclude;
 	}
 
-	DWORD lineNumber = GetSymbolLineNumber(pSymbol);
-	if (lineNumber != 0)
-		functionObject["LineNumber"] = lineNumber;
+private:
+	static constexpr size_t MaxStates = 4096;
+	static constexpr size_t Unknown = SIZE_MAX;
 
-	// Virtual Offset
-	uintptr_t virtualAddress = 0;
-	pSymbol->get_virtualAddress((ULONGLONG*)&virtualAddress);
-	functionObject["VirtualOffset"] = virtualAddress;
+	struct DfaState {
+		std::vector<size_t> nfaStates;  // Sorted; only character-consuming and accepting states
+		bool include = false;
+		bool exclude = false;
+		size_t asciiNext[128];
+		std::unordered_map<wchar_t, size_t> otherNext;
+	};
 
-	// Parameters
-	json paramsArray = json::array();
-	CComPtr<IDiaEnumSymbols> pParams;
-	HRESULT hr = pSymbol->findChildren(SymTagFunctionArgType, NULL, nsNone, &pParams);
-	if (SUCCEEDED(hr)) {
-		CComPtr<IDiaSymbol> pParam;
-		ULONG celtParam = 0;
-		while (SUCCEEDED(pParams->Next(1, &pParam, &celtParam)) && celtParam == 1) {
-			json paramObject;
+	void Flush() {
+		states.clear();
+		ids.clear();
+		visitStamps.assign(source->GetStates().size(), 0);
+		std::vector<size_t> startSet;
+		visitStamp++;
+		for (size_t start : source->GetStarts())
+			AddClosure(start, startSet);
+		startState = Intern(std::move(startSet));
+		deadState = Intern(std::vector<size_t>());
+	}
 
-			// Parameter type
-			CComPtr<IDiaSymbol> pType;
-			pParam->get_type(&pType);
-			std::wstring paramTypeName = GetTypeName(pType);
-			paramObject["Type"] = WStringToString(paramTypeName);
+	// Adds the states reachable from nfaState without consuming a character. States visited since
+	// visitStamp was last bumped are skipped, which also ends epsilon cycles such as re:(a*)*.
+	void AddClosure(size_t nfaState, std::vector<size_t>& set) {
+		const std::vector<NameAutomaton::State>& nfa = source->GetStates();
+		while (nfaState != NameAutomaton::NoState && visitStamps[nfaState] != visitStamp) {
+			visitStamps[nfaState] = visitStamp;
+			const NameAutomaton::State& state = nfa[nfaState];
+			if (state.kind != NameAutomaton::StateSplit) {
+				set.push_back(nfaState);
+				return;
+			}
+			if (state.alt != NameAutomaton::NoState)
+				AddClosure(state.alt, set);
+			nfaState = state.next;
+		}
+	}
+
+	size_t Intern(std::vector<size_t> set) {
+		std::sort(set.begin(), set.end());
+		auto it = ids.find(set);
+		if (it != ids.end())
+			return it->second;
 
-			paramsArray.push_back(paramObject);
-			pParam.Release();
+		DfaState state;
+		for (size_t nfaState : set) {
+			const NameAutomaton::State& nfa = source->GetStates()[nfaState];
+			if (nfa.kind == NameAutomaton::StateAccept)
+				(nfa.exclude ? state.exclude : state.include) = true;
 		}
+		std::fill(std::begin(state.asciiNext), std::end(state.asciiNext), Unknown);
+		state.nfaStates = set;
+		states.push_back(std::move(state));
+		ids.emplace(std::move(set), states.size() - 1);
+		return states.size() - 1;
 	}
-	functionObject["Parameters"] = paramsArray;
 
-	functionsArray.push_back(functionObject);
-}
+	size_t Step(size_t state, wchar_t c) {
+		size_t cached = Unknown;
+		if (static_cast<uint32_t>(c) < 128) {
+			cached = states[state].asciiNext[c];
+		}
+		else {
+			auto it = states[state].otherNext.find(c);
+			if (it != states[state].otherNext.end())
+				cached = it->second;
+		}
+		if (cached != Unknown)
+			return cached;
 
-void ProcessData(CComPtr<IDiaSymbol> pSymbol, json& globalsArray, const std::wstring& filePrefix, LONG totalSymbols, LONG& processedSymbols, double& lastProgressPercentage) {
-	json dataObject;
+		const std::vector<NameAutomaton::State>& nfa = source->GetStates();
+		std::vector<size_t> nextSet;
+		visitStamp++;
+		for (size_t nfaState : states[state].nfaStates) {
+			const NameAutomaton::State& s = nfa[nfaState];
+			bool consumes = s.kind == NameAutomaton::StateAny
+				|| (s.kind == NameAutomaton::StateChar && s.c == c)
+				|| (s.kind == NameAutomaton::StateClass && source->GetClasses()[s.classIndex].Contains(c));
+			if (consumes)
+				AddClosure(s.next, nextSet);
+		}
 
-	// Get variable name
-	std::wstring varName = GetSymbolName(pSymbol);
-	dataObject["Name"] = WStringToString(varName);
+		if (states.size() >= MaxStates) {
+			Flush();
+			return Intern(std::move(nextSet));
+		}
 
-	// Type
-	CComPtr<IDiaSymbol> pType;
-	pSymbol->get_type(&pType);
-	std::wstring typeName = GetTypeName(pType);
-	dataObject["Type"] = WStringToString(typeName);
+		size_t next = Intern(std::move(nextSet));
+		if (static_cast<uint32_t>(c) < 128)
+			states[state].asciiNext[c] = next;
+		else
+			states[state].otherNext.emplace(c, next);
+		return next;
+	}
 
-	// Is static
-	DWORD locationType = 0;
-	pSymbol->get_locationType(&locationType);
-	dataObject["IsStatic"] = (locationType == LocIsStatic) ? true : false;
+	const NameAutomaton* source = nullptr;
+	std::vector<DfaState> states;
+	std::map<std::vector<size_t>, size_t> ids;
+	std::vector<size_t> visitStamps;
+	size_t visitStamp = 0;
+	size_t startState = 0;
+	size_t deadState = 0;
+};
 
-	// Is const
-	BOOL isConst = FALSE;
-	pSymbol->get_constType(&isConst);
-	dataObject["IsConst"] = isConst ? true : false;
-
-	// Get variable definition file and line number
-	std::wstring fileName = GetSymbolFileName(pSymbol);
-	if (!fileName.empty()) {
-		// Apply file prefix filter
-		if (!filePrefix.empty()) {
-			if (fileName.find(filePrefix) != 0) {
-				// The file name does not start with the prefix, skip this variable
-				return;
-			}
+// Include and exclude rules on source file paths and qualified names. File patterns without
+// wildcards are prefixes and live in a trie, so every prefix rule is checked in one walk over the
+// path; patterns with wildcards are globs in which * stays within a path component, ** crosses
+// components and ? matches one character. Paths compare case-insensitively, and / and \ are
+// the same. Name rules are compiled into a NameAutomaton. A path or name passes when no
+// exclude rule matches it and, if there are include rules, one of them does.
+class SymbolFilter {
+public:
+	bool AddNameRule(const std::wstring& pattern, bool exclude) {
+		std::wstring error;
+		if (nameRules.AddRule(pattern, exclude, error)) {
+			AddToFingerprint(L'n', pattern, exclude);
+			return true;
 		}
-		dataObject["SourceFile"] = WStringToString(fileName);
+		std::wcerr << L"Invalid name pattern " << pattern << L": " << error << std::endl;
+		return false;
 	}
 
-	DWORD lineNumber = GetSymbolLineNumber(pSymbol);
-	if (lineNumber != 0)
-		dataObject["LineNumber"] = lineNumber;
-
-	// Virtual Offset
-	uintptr_t virtualAddress = 0;
-	pSymbol->get_virtualAddress((ULONGLONG*)&virtualAddress);
-	dataObject["VirtualOffset"] = virtualAddress;
+	bool HasNameRules() const {
+		return !nameRules.IsEmpty();
+	}
 
-	globalsArray.push_back(dataObject);
-}
+	const NameAutomaton& GetNameRules() const {
+		return nameRules;
+	}
 
-// Helper functions
+	// Hash of every rule in the order it was added, for telling filtered dumps apart
+	ULONGLONG GetFingerprint() const {
+		return fingerprint;
+	}
 
-std::wstring GetSymbolName(CComPtr<IDiaSymbol> pSymbol) {
-	BSTR bstrName = NULL;
-	pSymbol->get_name(&bstrName);
-	std::wstring name = bstrName ? bstrName : L"";
-	SysFreeString(bstrName);
-	return name;
-}
+	void AddFileRule(const std::wstring& pattern, bool exclude) {
+		if (pattern.empty())
+			return;
+		if (!exclude)
+			hasFileIncludes = true;
+		AddToFingerprint(L'f', pattern, exclude);
 
-std::wstring GetUndecoratedName(CComPtr<IDiaSymbol> pSymbol) {
-	BSTR bstrName = NULL;
-	pSymbol->get_undecoratedName(&bstrName);
-	std::wstring name = bstrName ? bstrName : L"";
-	SysFreeString(bstrName);
-	return name;
-}
+		if (pattern.find_first_of(L"*?") != std::wstring::npos) {
+			globRules.push_back({ pattern, exclude });
+			return;
+		}
 
-std::wstring GetSymbolFileName(CComPtr<IDiaSymbol> pSymbol) {
-	// Try to get the source file name directly
-	BSTR bstrFileName = NULL;
-	HRESULT hr = pSymbol->get_sourceFileName(&bstrFileName);
-	if (SUCCEEDED(hr) && bstrFileName) {
-		std::wstring fileName = bstrFileName;
-		SysFreeString(bstrFileName);
-		return fileName;
+		size_t node = 0;
+		for (wchar_t c : pattern) {
+			wchar_t key = FoldPathChar(c);
+			auto it = trieNodes[node].children.find(key);
+			if (it == trieNodes[node].children.end()) {
+				trieNodes.emplace_back();
+				it = trieNodes[node].children.emplace(key, trieNodes.size() - 1).first;
+			}
+			node = it->second;
+		}
+		(exclude ? trieNodes[node].exclude : trieNodes[node].include) = true;
 	}
 
-	// If the above fails, try to get it via the line number
-	CComPtr<IDiaLineNumber> pLineNumber;
-	hr = pSymbol->getSrcLineOnTypeDefn(&pLineNumber);
-	if (SUCCEEDED(hr) && pLineNumber) {
-		CComPtr<IDiaSourceFile> pSourceFile;
-		hr = pLineNumber->get_sourceFile(&pSourceFile);
-		if (SUCCEEDED(hr) && pSourceFile) {
-			hr = pSourceFile->get_fileName(&bstrFileName);
-			if (SUCCEEDED(hr) && bstrFileName) {
-				std::wstring fileName = bstrFileName;
-				SysFreeString(bstrFileName);
-				return fileName;
+	// One rule per line: "-pattern" excludes, "pattern" or "+pattern" includes, and a pattern
+	// starting with "name:" is a name rule; blank lines and lines starting with # are skipped
+	bool LoadFileRules(const std::wstring& path) {
+		std::filesystem::path rulesPath(path);
+		std::ifstream rulesFile(rulesPath);
+		if (!rulesFile) {
+			std::wcerr << L"Failed to open " << path << std::endl;
+			return false;
+		}
+
+		std::string line;
+		while (std::getline(rulesFile, line)) {
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			if (line.empty() || line[0] == '#')
+				continue;
+
+			bool exclude = line[0] == '-';
+			if (line[0] == '-' || line[0] == '+')
+				line.erase(0, 1);
+			if (line.compare(0, 5, "name:") == 0) {
+				std::wstring pattern = std::filesystem::u8path(line.substr(5)).wstring();
+				if (!AddNameRule(pattern, exclude))
+					return false;
+				continue;
 			}
+			AddFileRule(std::filesystem::u8path(line).wstring(), exclude);
 		}
+		return true;
 	}
 
-	return L"";
-}
+	bool HasFileRules() const {
+		return trieNodes.size() > 1 || !globRules.empty();
+	}
+
+	bool MatchesFile(std::wstring_view path) const {
+		bool included = !hasFileIncludes;
+		size_t node = 0;
+		for (size_t i = 0;; i++) {
+			if (trieNodes[node].exclude)
+				return false;
+			if (trieNodes[node].include)
+				included = true;
+			if (i == path.size())
+				break;
+
+			auto it = trieNodes[node].children.find(FoldPathChar(path[i]));
+			if (it == trieNodes[node].children.end())
+				break;
+			node = it->second;
+		}
+
+		for (const GlobRule& rule : globRules) {
+			if ((rule.exclude || !included) && MatchGlob(rule.pattern, path)) {
+				if (rule.exclude)
+					return false;
+				included = true;
+			}
+		}
+		return included;
+	}
+
+private:
+	struct TrieNode {
+		std::map<wchar_t, size_t> children;
+		bool include = false;
+		bool exclude = false;
+	};
+	struct GlobRule {
+		std::wstring pattern;
+		bool exclude;
+	};
+
+	static wchar_t FoldPathChar(wchar_t c) {
+		if (c == L'/')
+			return L'\\';
+		if (c >= L'A' && c <= L'Z')
+			return c - L'A' + L'a';
+		return c;
+	}
+
+	static bool MatchGlob(std::wstring_view pattern, std::wstring_view text) {
+		size_t p = 0;
+		size_t t = 0;
+		while (p < pattern.size()) {
+			if (pattern[p] == L'*') {
+				bool crossesComponents = p + 1 < pattern.size() && pattern[p + 1] == L'*';
+				std::wstring_view rest = pattern.substr(p + (crossesComponents ? 2 : 1));
+				for (size_t end = t;; end++) {
+					if (MatchGlob(rest, text.substr(end)))
+						return true;
+					if (end == text.size() || (!crossesComponents && FoldPathChar(text[end]) == L'\\'))
+						return false;
+				}
+			}
+
+			if (t == text.size())
+				return false;
+			wchar_t c = FoldPathChar(text[t]);
+			if (pattern[p] == L'?' ? c == L'\\' : FoldPathChar(pattern[p]) != c)
+				return false;
+			p++;
+			t++;
+		}
+		return t == text.size();
+	}
+
+	void AddToFingerprint(wchar_t kind, const std::wstring& pattern, bool exclude) {
+		wchar_t header[2] = { kind, exclude ? L'-' : L'+' };
+		fingerprint = HashBytes(header, sizeof(header), fingerprint);
+		fingerprint = HashBytes(pattern.c_str(), (pattern.size() + 1) * sizeof(wchar_t), fingerprint);
+	}
+
+	std::vector<TrieNode> trieNodes = std::vector<TrieNode>(1);
+	std::vector<GlobRule> globRules;
+	bool hasFileIncludes = false;
+	NameAutomaton nameRules;
+	ULONGLONG fingerprint = 0;
+};
+
+// cv flags stored in TypeDescriptor
+enum TypeCvFlags : DWORD {
+	TypeCvConst = 0x1,
+	TypeCvVolatile = 0x2,
+};
+
+// Compact structured form of a resolved type, so consumers don't have to re-parse "Foo*[16]".
+// Array dimensions are peeled first (outermost first), then pointer levels; whatever remains is
+// the base type. A pointer to an array keeps the array as its base type.
+struct TypeDescriptor {
+	DWORD kind = SymTagNull;            // SymTag of the base type
+	ULONGLONG baseTypeId = 0;           // Type ID of the base type
+	DWORD pointerDepth = 0;
+	bool isReference = false;           // Outermost pointer level is a reference
+	std::vector<DWORD> arrayDimensions; // Outermost dimension first
+	DWORD cvFlags = 0;                  // TypeCvFlags of the type itself
+	std::vector<DWORD> pointerCvFlags;  // TypeCvFlags of each pointer level, outermost first
+	DWORD baseCvFlags = 0;              // TypeCvFlags of the base type
+	ULONGLONG size = 0;                 // Size of the whole type in bytes
+};
+
+// Everything the resolver knows about a type, computed once per type.
+// `typeId` is derived from the type's name and shape (plus the member names of classes and enums)
+// rather than from DIA's symIndexId, which is only meaningful within one session; this keeps IDs
+// identical across worker sessions and runs.
+struct ResolvedType {
+	InternedString name;
+	TypeDescriptor descriptor;
+	ULONGLONG typeId = 0;
+};
+
+// Virtual function tables of a class, one per vfptr. Tables in the non-virtual part are identified
+// by the offset of their vfptr in the class; those of virtual bases, which have no fixed offset, by
+// the virtual base and the offset of the vfptr inside it. Slots are byte offsets into a table;
+// overrides don't carry their own offset in the PDB, so they take the slot of the base method with
+// the same signature.
+struct VTableLayout {
+	struct Table {
+		InternedString virtualBase; // Empty for tables in the non-virtual part
+		LONG vfptrOffset = 0;
+		std::unordered_map<std::wstring, DWORD> slotsBySignature;
+	};
+	struct Slot {
+		size_t table = 0; // Index into `tables`
+		DWORD offset = 0;
+	};
+	std::vector<Table> tables;
+	std::unordered_map<DWORD, Slot> slotsByMethodId; // This class's virtual methods, by symIndexId
+};
+
+enum LayoutEntryKind {
+	LayoutField,
+	LayoutVfPtr,   // Virtual function table pointer
+	LayoutVbPtr,   // Virtual base table pointer
+	LayoutPadding,
+};
+
+// One member of a flattened class layout, at an offset relative to the start of the class
+struct LayoutEntry {
+	LayoutEntryKind kind = LayoutField;
+	InternedString name;
+	InternedString typeName;
+	InternedString declaringClass;
+	LONGLONG offset = 0;
+	ULONGLONG size = 0;        // For bitfields, the size of the storage unit
+	bool isBitField = false;
+	DWORD bitPosition = 0;
+	ULONGLONG bitWidth = 0;
+	bool inVirtualBase = false;
+};
+
+// Layout of a class as it appears inside other objects. `entries` covers the non-virtual part
+// (own members plus non-virtual bases, flattened); virtual bases are only placed when the class
+// is the complete object, so they are kept as references to their own memoized layouts.
+struct ClassLayout {
+	InternedString name;
+	ULONGLONG size = 0;
+	ULONGLONG nonVirtualSize = 0; // Size of the class as a base: `entries` rounded up to `alignment`
+	ULONGLONG alignment = 1;      // Estimated from the members; the PDB doesn't record it
+	std::vector<LayoutEntry> entries;
+	std::vector<const ClassLayout*> virtualBases; // In MSVC placement order
+};
+
+// Definition file and line of a symbol
+struct SourceLocation {
+	InternedString file;
+	DWORD lineNumber = 0;
+};
+
+// Identity of a class for deduplication: the same class is often listed once per compiland that
+// uses it, and anonymous types of the same shape share a name
+struct ClassKey {
+	std::wstring name;
+	ULONGLONG size = 0;
+	ULONGLONG fieldHash = 0; // Names, type IDs and offsets of the data members, 0 unless Fields are extracted
+
+	bool operator==(const ClassKey& other) const {
+		return size == other.size && fieldHash == other.fieldHash && name == other.name;
+	}
+};
+
+struct ClassKeyHash {
+	size_t operator()(const ClassKey& key) const {
+		return static_cast<size_t>(HashBytes(&key.fieldHash, sizeof(key.fieldHash),
+			HashBytes(&key.size, sizeof(key.size), std::hash<std::wstring>()(key.name))));
+	}
+};
+
+// Member hashes of a class for --incremental: what its record emits of them, its structure for
+// the layouts of derived classes, and the data members for its key
+struct ClassMemberHashes {
+	ULONGLONG record = 0;
+	ULONGLONG layout = 0;
+	ULONGLONG fields = 0;
+};
+
+// Claims on class keys by position in the top-level symbol list, shared by every session of one
+// dump. The first class in symbol order with a given key is emitted and later ones are skipped
+// once their data members are read. Workers extract chunks out of order, so a class can be claimed
+// before an earlier duplicate turns up; it then loses its claim and is dropped when its chunk is
+// serialized. Chunks are serialized in order, so by then every earlier position has claimed.
+class ClassDedupTable {
+public:
+	struct Entry {
+		std::atomic<size_t> owner;
+	};
+
+	// Returns the key's entry, or null if a class at an earlier position already holds the key
+	Entry* Claim(ClassKey&& key, size_t position) {
+		Shard& shard = shards[ClassKeyHash()(key) % ShardCount];
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		auto inserted = shard.entries.try_emplace(std::move(key));
+		Entry& entry = inserted.first->second;
+		if (inserted.second) {
+			entry.owner = position;
+			return &entry;
+		}
+		if (entry.owner < position) {
+			duplicateCount++;
+			return nullptr;
+		}
+		entry.owner = position;
+		return &entry;
+	}
+
+	void AddDuplicates(size_t count) {
+		duplicateCount += count;
+	}
+
+	size_t GetDuplicateCount() const {
+		return duplicateCount;
+	}
+
+private:
+	static const size_t ShardCount = 64;
+
+	struct Shard {
+		std::mutex mutex;
+		std::unordered_map<ClassKey, Entry, ClassKeyHash> entries; // Nodes never move, so entries stay valid
+	};
+	Shard shards[ShardCount];
+	std::atomic<size_t> duplicateCount{ 0 };
+};
+
+// Everything tied to one open DIA session. Symbol IDs are only meaningful within the session that
+// handed them out, so every cache keyed by symIndexId lives here. A session must not be shared
+// between threads: each extraction worker opens its own and points `sessionContext` at it.
+struct SessionContext {
+	CComPtr<IDiaDataSource> pSource;
+	CComPtr<IDiaSession> pSession;
+	CComPtr<IDiaSymbol> pGlobal;
+
+	// Interned names of the PDB, shared with its other sessions
+	NamePools* namePools = nullptr;
+
+	// Size of a vtable slot in the target image
+	DWORD pointerSize = sizeof(void*);
+
+	// Type cache to optimize GetTypeName function
+	std::unordered_map<ULONGLONG, ResolvedType> typeCache;
+
+	// Vtable and class layouts are built once per class and shared by every class deriving from it
+	std::unordered_map<DWORD, VTableLayout> vtableCache;
+	std::unordered_map<DWORD, ClassLayout> layoutCache;
+
+	// Source file names by IDiaSourceFile unique ID, so each file's name is fetched once
+	std::unordered_map<DWORD, InternedString> sourceFileCache;
+
+	// File filter result by interned file name
+	std::unordered_map<DWORD, bool> fileFilterResults;
+
+	// Name filter rules as a lazily built DFA
+	NameDfa nameDfa;
+
+	// Compilands with no source file that passes the file filter, found on first use
+	std::unordered_set<DWORD> excludedCompilands;
+	bool compilandsScanned = false;
+
+	// Class claims of the dump this session belongs to (null when not deduplicating), and the
+	// position of the top-level symbol being extracted
+	ClassDedupTable* classDedup = nullptr;
+	size_t symbolPosition = 0;
+
+	// Records of the previous dump for --incremental (null without it), and the member hash of
+	// every class hashed so far
+	const RecordStore* previousRecords = nullptr;
+	std::unordered_map<DWORD, ClassMemberHashes> classMemberHashes;
+
+	// Drops the COM objects (on the thread that created them) but keeps the caches
+	void Close() {
+		pGlobal.Release();
+		pSession.Release();
+		pSource.Release();
+	}
+};
+thread_local SessionContext* sessionContext = nullptr;
+
+// Top-level symbols are handed to worker threads in chunks of this many symbols
+const size_t SymbolsPerChunk = 256;
+
+// A class's claim in the ClassDedupTable, checked again when its chunk is serialized
+struct ClassClaim {
+	const ClassDedupTable::Entry* entry;
+	size_t position;
+};
+
+// Range of addresses a function or variable occupies, read during extraction whatever --fields
+// leaves in its record
+struct AddressRange {
+	ULONGLONG virtualOffset = 0;
+	ULONGLONG size = 0;
+};
+
+// Output arrays for one chunk of top-level symbols
+struct SymbolArrays {
+	json classes = json::array();
+	std::vector<ClassClaim> classClaims; // One per class when deduplicating
+	std::vector<ULONGLONG> classHashes;  // Record hashes, one per class, enum and function, with --incremental
+	std::vector<ULONGLONG> enumHashes;
+	std::vector<ULONGLONG> functionHashes;
+	std::vector<AddressRange> functionRanges; // Address and code length of every function, with --database
+	std::vector<AddressRange> globalRanges;   // Address and size of every variable, with --database
+	json enums = json::array();
+	json functions = json::array();
+	json globals = json::array();
+	json typedefs = json::array();
+};
+
+// One deque of chunk indices per worker. Owners pop from the front, so each worker walks its own
+// contiguous range in order; idle workers steal from the back of the others. Every deque holds an
+// ascending run of chunks, so its front is its oldest chunk.
+class WorkStealingQueues {
+public:
+	enum PopResult {
+		PopTaken,
+		PopBlocked, // Chunks are left, but none below the limit
+		PopEmpty
+	};
+
+	explicit WorkStealingQueues(size_t workerCount) {
+		for (size_t i = 0; i < workerCount; i++)
+			queues.emplace_back(new Queue);
+	}
+
+	void Push(size_t worker, size_t chunk) {
+		std::lock_guard<std::mutex> lock(queues[worker]->mutex);
+		queues[worker]->chunks.push_back(chunk);
+	}
+
+	// Takes a chunk with an index below `limit`: the worker's own next chunk, else one stolen from
+	// the back of another queue, else the oldest chunk of another queue. Falling back to the oldest
+	// chunks guarantees that the chunk the pipeline is waiting for is always taken by someone.
+	PopResult Pop(size_t worker, size_t limit, size_t& chunk) {
+		bool remaining = false;
+		for (int pass = 0; pass < 3; pass++) {
+			for (size_t i = (pass == 0 ? 0 : 1); i < (pass == 0 ? 1 : queues.size()); i++) {
+				Queue& queue = *queues[(worker + i) % queues.size()];
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				if (queue.chunks.empty())
+					continue;
+				remaining = true;
+
+				bool fromBack = pass == 1;
+				size_t candidate = fromBack ? queue.chunks.back() : queue.chunks.front();
+				if (candidate >= limit)
+					continue;
+
+				chunk = candidate;
+				if (fromBack)
+					queue.chunks.pop_back();
+				else
+					queue.chunks.pop_front();
+				return PopTaken;
+			}
+		}
+		return remaining ? PopBlocked : PopEmpty;
+	}
+
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<size_t> chunks;
+	};
+	std::vector<std::unique_ptr<Queue>> queues;
+};
+
+// Fixed-capacity queue between two pipeline stages. Push blocks while the queue is full, so a
+// fast producer can't run ahead of a slow consumer.
+template <typename T>
+class BoundedQueue {
+public:
+	explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+	void Push(T item) {
+		std::unique_lock<std::mutex> lock(mutex);
+		notFull.wait(lock, [&] { return items.size() < capacity; });
+		items.push_back(std::move(item));
+		notEmpty.notify_one();
+	}
+
+	// Returns false once the queue is closed and drained
+	bool Pop(T& item) {
+		std::unique_lock<std::mutex> lock(mutex);
+		notEmpty.wait(lock, [&] { return !items.empty() || closed; });
+		if (items.empty())
+			return false;
+		item = std::move(items.front());
+		items.pop_front();
+		notFull.notify_one();
+		return true;
+	}
+
+	void Close() {
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+		notEmpty.notify_all();
+	}
+
+private:
+	size_t capacity;
+	bool closed = false;
+	std::deque<T> items;
+	std::mutex mutex;
+	std::condition_variable notFull;
+	std::condition_variable notEmpty;
+};
+
+// Hands finished chunks to the serializer in chunk order. Extraction may only run `window` chunks
+// ahead of serialization, which bounds the JSON held in memory for chunks waiting their turn.
+class ChunkReorderBuffer {
+public:
+	ChunkReorderBuffer(size_t chunkCount, size_t window) : ready(chunkCount, false), window(window) {}
+
+	// Chunks below this index may be extracted
+	size_t GetLimit() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return next + window;
+	}
+
+	// Blocks until serialization has moved past the given limit
+	void WaitForLimitAbove(size_t limit) {
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [&] { return next + window > limit; });
+	}
+
+	void MarkReady(size_t chunk) {
+		std::lock_guard<std::mutex> lock(mutex);
+		ready[chunk] = true;
+		changed.notify_all();
+	}
+
+	// Blocks until the oldest unserialized chunk is ready and returns it; false when all are done
+	bool WaitForNext(size_t& chunk) {
+		std::unique_lock<std::mutex> lock(mutex);
+		if (next == ready.size())
+			return false;
+		changed.wait(lock, [&] { return ready[next]; });
+		chunk = next;
+		return true;
+	}
+
+	void Release(size_t chunk) {
+		std::lock_guard<std::mutex> lock(mutex);
+		next = chunk + 1;
+		changed.notify_all();
+	}
+
+private:
+	std::vector<bool> ready;
+	size_t window;
+	size_t next = 0;
+	std::mutex mutex;
+	std::condition_variable changed;
+};
+
+// Fixed set of threads shared by every PDB being dumped. Each thread initializes COM once and then
+// runs jobs in submission order, so back-to-back PDBs don't pay for thread and COM start-up.
+class ThreadPool {
+public:
+	explicit ThreadPool(size_t threadCount) {
+		for (size_t i = 0; i < threadCount; i++)
+			threads.emplace_back([this] { Run(); });
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			jobAvailable.notify_all();
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	void Submit(std::function<void()> job) {
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+		jobAvailable.notify_one();
+	}
+
+	size_t GetThreadCount() const { return threads.size(); }
+
+private:
+	void Run() {
+		CoInitialize(NULL);
+		for (;;) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				jobAvailable.wait(lock, [&] { return !jobs.empty() || stopping; });
+				if (jobs.empty())
+					break;
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			job();
+		}
+		CoUninitialize();
+	}
+
+	std::vector<std::thread> threads;
+	std::deque<std::function<void()>> jobs;
+	bool stopping = false;
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+};
+
+// Lets a thread wait, with a timeout, for a known number of jobs to finish
+class CompletionLatch {
+public:
+	explicit CompletionLatch(size_t count) : remaining(count) {}
+
+	void CountDown() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--remaining == 0)
+			done.notify_all();
+	}
+
+	// Returns true once every job has finished
+	bool WaitFor(std::chrono::milliseconds timeout) {
+		std::unique_lock<std::mutex> lock(mutex);
+		return done.wait_for(lock, timeout, [&] { return remaining == 0; });
+	}
+
+private:
+	size_t remaining;
+	std::mutex mutex;
+	std::condition_variable done;
+};
+
+// Output records of one top-level array, kept in their original order until the array can be
+// written. Records are stored as length-prefixed MessagePack, which is several times smaller
+// than the indented text; Spill moves them to a temporary file so memory can be given back.
+class RecordSpool {
+public:
+	RecordSpool() = default;
+	RecordSpool(const RecordSpool&) = delete;
+	RecordSpool& operator=(const RecordSpool&) = delete;
+
+	~RecordSpool() {
+		if (file.is_open()) {
+			file.close();
+			std::error_code ec;
+			std::filesystem::remove(filePath, ec);
+		}
+	}
+
+	void Add(const json& record) {
+		std::vector<std::uint8_t> packed = json::to_msgpack(record);
+		std::uint32_t length = static_cast<std::uint32_t>(packed.size());
+		buffer.append(reinterpret_cast<const char*>(&length), sizeof(length));
+		buffer.append(packed.begin(), packed.end());
+		recordCount++;
+	}
+
+	size_t GetRecordCount() const { return recordCount; }
+	size_t GetMemoryBytes() const { return buffer.size(); }
+	ULONGLONG GetSpilledBytes() const { return spilledBytes; }
+
+	// Appends the in-memory records to the spool file. Returns false if the file can't be written,
+	// in which case the records stay in memory.
+	bool Spill() {
+		if (buffer.empty())
+			return true;
+
+		if (!file.is_open()) {
+			static std::atomic<unsigned> spoolCounter(0);
+			std::error_code ec;
+			filePath = std::filesystem::temp_directory_path(ec) /
+				(L"PDBToJSON-" + std::to_wstring(GetCurrentProcessId()) + L"-" + std::to_wstring(spoolCounter++) + L".spool");
+			file.open(filePath, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+			if (ec || !file.is_open())
+				return false;
+		}
+
+		file.write(buffer.data(), buffer.size());
+		if (!file)
+			return false;
+		spilledBytes += buffer.size();
+		std::string().swap(buffer);
+		return true;
+	}
+
+	// Calls `callback` with every record in the order they were added. Returns false if the spool
+	// file can't be read back or was damaged.
+	template <typename Callback>
+	bool Drain(Callback&& callback) {
+		std::string record;
+		if (file.is_open()) {
+			file.flush();
+			file.seekg(0);
+			for (ULONGLONG offset = 0; offset < spilledBytes; offset += sizeof(std::uint32_t) + record.size()) {
+				// A damaged length must not reach past what was spilled
+				std::uint32_t length = 0;
+				file.read(reinterpret_cast<char*>(&length), sizeof(length));
+				if (!file || spilledBytes - offset < sizeof(length) || length > spilledBytes - offset - sizeof(length))
+					return false;
+				record.resize(length);
+				file.read(&record[0], length);
+				if (!file)
+					return false;
+				json value = json::from_msgpack(record, true, false);
+				if (value.is_discarded())
+					return false;
+				callback(std::move(value));
+			}
+		}
+
+		for (size_t offset = 0; offset < buffer.size(); offset += sizeof(std::uint32_t) + record.size()) {
+			std::uint32_t length = 0;
+			memcpy(&length, buffer.data() + offset, sizeof(length));
+			record.assign(buffer, offset + sizeof(length), length);
+			callback(json::from_msgpack(record));
+		}
+		return true;
+	}
+
+private:
+	std::string buffer;
+	size_t recordCount = 0;
+	std::fstream file;
+	std::filesystem::path filePath;
+	ULONGLONG spilledBytes = 0;
+};
+
+// Output of the kinds that follow "Classes", held until the class array is complete
+struct KindSpool {
+	RecordSpool enums;
+	RecordSpool functions;
+	RecordSpool globals;
+	RecordSpool typedefs;
+	bool firstClass = true;
+	bool spillFailed = false;
+
+	size_t GetMemoryBytes() const {
+		return enums.GetMemoryBytes() + functions.GetMemoryBytes() + globals.GetMemoryBytes() + typedefs.GetMemoryBytes();
+	}
+
+	ULONGLONG GetSpilledBytes() const {
+		return enums.GetSpilledBytes() + functions.GetSpilledBytes() + globals.GetSpilledBytes() + typedefs.GetSpilledBytes();
+	}
+
+	// Moves everything to disk once the memory budget is exceeded
+	void EnforceBudget(ULONGLONG budget) {
+		if (budget == 0 || spillFailed || GetMemoryBytes() <= budget)
+			return;
+
+		if (!enums.Spill() || !functions.Spill() || !globals.Spill() || !typedefs.Spill()) {
+			std::wcerr << L"Failed to write a spool file, keeping output in memory" << std::endl;
+			spillFailed = true;
+		}
+	}
+};
+
+// Record file written next to every --incremental dump (<dump>.records): the output options hash,
+// then each class, enum and function record as its record hash and length-prefixed MessagePack.
+// The record hash covers everything the record is built from, so the next build can take a
+// record with the same hash from here instead of extracting it again.
+class RecordStore {
+public:
+	static constexpr char Magic[8] = { 'P', 'D', 'B', 'J', 'R', 'E', 'C', '1' };
+
+	RecordStore() = default;
+	RecordStore(const RecordStore&) = delete;
+	RecordStore& operator=(const RecordStore&) = delete;
+	~RecordStore() { Clear(); }
+
+	// Maps a record file and indexes its records. Only the index is kept in memory; a record is
+	// read from the mapping when it is found. Returns false if the file is missing, damaged or
+	// was written with other options.
+	bool Load(const std::wstring& path, ULONGLONG optionsHash) {
+		Clear();
+		file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0)
+			return Clear();
+		mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping)
+			view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!view)
+			return Clear();
+		data = static_cast<const char*>(view);
+		size = static_cast<size_t>(fileSize.QuadPart);
+
+		ULONGLONG fileOptionsHash = 0;
+		if (size < sizeof(Magic) + sizeof(fileOptionsHash) || memcmp(data, Magic, sizeof(Magic)) != 0)
+			return Clear();
+		memcpy(&fileOptionsHash, data + sizeof(Magic), sizeof(fileOptionsHash));
+		if (fileOptionsHash != optionsHash)
+			return Clear();
+
+		const size_t entryHeader = sizeof(ULONGLONG) + sizeof(std::uint32_t);
+		for (size_t offset = sizeof(Magic) + sizeof(fileOptionsHash); offset < size;) {
+			ULONGLONG hash = 0;
+			std::uint32_t length = 0;
+			if (size - offset < entryHeader)
+				return Clear();
+			memcpy(&hash, data + offset, sizeof(hash));
+			memcpy(&length, data + offset + sizeof(hash), sizeof(length));
+			offset += entryHeader;
+			if (size - offset < length)
+				return Clear();
+			records.emplace(hash, std::make_pair(offset, static_cast<size_t>(length)));
+			offset += length;
+		}
+		return true;
+	}
+
+	// Fills `record` with the previous record of the given hash, if there is one and it decodes
+	bool Find(ULONGLONG hash, json& record) const {
+		auto it = records.find(hash);
+		if (it == records.end())
+			return false;
+		const char* begin = data + it->second.first;
+		json previous = json::from_msgpack(begin, begin + it->second.second, true, false);
+		if (previous.is_discarded())
+			return false;
+		record = std::move(previous);
+		reusedCount++;
+		return true;
+	}
+
+	// Unmaps the file, which can then be replaced
+	void Close() { Clear(); }
+
+	size_t GetRecordCount() const { return records.size(); }
+	size_t GetReusedCount() const { return reusedCount; }
+
+	static void WriteHeader(std::ostream& out, ULONGLONG optionsHash) {
+		out.write(Magic, sizeof(Magic));
+		out.write(reinterpret_cast<const char*>(&optionsHash), sizeof(optionsHash));
+	}
+
+	static void WriteRecord(std::ostream& out, ULONGLONG hash, const json& record) {
+		std::vector<std::uint8_t> packed = json::to_msgpack(record);
+		std::uint32_t length = static_cast<std::uint32_t>(packed.size());
+		out.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+		out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+		out.write(reinterpret_cast<const char*>(packed.data()), packed.size());
+	}
+
+private:
+	bool Clear() {
+		if (view)
+			UnmapViewOfFile(view);
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		view = nullptr;
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+		data = nullptr;
+		size = 0;
+		records.clear();
+		return false;
+	}
+
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+	void* view = nullptr;
+	const char* data = nullptr;
+	size_t size = 0;
+	std::unordered_map<ULONGLONG, std::pair<size_t, size_t>> records; // Hash to offset and length in `data`
+	mutable std::atomic<size_t> reusedCount{ 0 };
+};
+
+// Value of a key of a record, or the default if the key is missing or of another type (the
+// record may have been projected with --fields)
+template<typename T>
+T GetRecordNumber(const json& record, const char* key) {
+	auto it = record.find(key);
+	return it != record.end() && it->is_number() ? it->get<T>() : T();
+}
+
+bool GetRecordFlag(const json& record, const char* key) {
+	auto it = record.find(key);
+	return it != record.end() && it->is_boolean() && it->get<bool>();
+}
+
+const std::string& GetRecordString(const json& record, const char* key) {
+	static const std::string empty;
+	auto it = record.find(key);
+	return it != record.end() && it->is_string() ? it->get_ref<const std::string&>() : empty;
+}
+
+const json& GetRecordArray(const json& record, const char* key) {
+	static const json empty = json::array();
+	auto it = record.find(key);
+	return it != record.end() && it->is_array() ? *it : empty;
+}
+
+// Builds the --database file (see PDBDatabase.h) from the records of a dump as the serializer
+// emits them, so the database holds exactly what the JSON does. Everything is held in memory
+// until Write, outside --memory-budget. Strings and records are addressed by 32-bit offsets and
+// indexes; a dump that outgrows them stops being collected and fails to write.
+class DatabaseBuilder {
+public:
+	DatabaseBuilder() {
+		strings.push_back('\0');
+	}
+
+	// `range` is where a function's code or a variable lies; other kinds have none
+	void AddSymbol(PdbDbSymbolKind kind, const json& record, const AddressRange& range = AddressRange()) {
+		if (overflowed)
+			return;
+
+		PdbDbSymbol symbol = {};
+		symbol.kind = kind;
+		symbol.name = AddString(GetRecordString(record, "Name"));
+		symbol.sourceFile = AddString(GetRecordString(record, "SourceFile"));
+		symbol.lineNumber = GetRecordNumber<uint32_t>(record, "LineNumber");
+		symbol.size = kind == PdbDbFunction || kind == PdbDbGlobal ? range.size : GetRecordNumber<uint64_t>(record, "Size");
+		symbol.virtualOffset = range.virtualOffset;
+		symbol.type = AddType(record, kind == PdbDbGlobal ? "Type" : "UnderlyingType");
+		symbol.flags = GetFlags(record);
+		symbol.firstMember = static_cast<uint32_t>(members.size());
+
+		for (const json& baseClass : GetRecordArray(record, "BaseClasses"))
+			AddMember(PdbDbBaseClass, baseClass);
+		for (const json& field : GetRecordArray(record, "Fields"))
+			AddMember(PdbDbField, field);
+		for (const json& method : GetRecordArray(record, "Methods")) {
+			const json& parameters = GetRecordArray(method, "Parameters");
+			AddMember(PdbDbMethod, method).parameterCount = static_cast<uint32_t>(parameters.size());
+			for (const json& parameter : parameters)
+				AddMember(PdbDbParameter, parameter);
+		}
+		if (kind == PdbDbFunction) {
+			for (const json& parameter : GetRecordArray(record, "Parameters"))
+				AddMember(PdbDbParameter, parameter);
+		}
+		for (const json& value : GetRecordArray(record, "Values"))
+			AddMember(PdbDbEnumValue, value).offset = GetRecordNumber<int64_t>(value, "Value");
+
+		// Member and symbol indexes must fit in 32 bits, below PDBDatabase::NotFound
+		if (members.size() >= UINT32_MAX || symbols.size() >= UINT32_MAX - 1)
+			SetOverflowed();
+		if (overflowed)
+			return;
+		symbol.memberCount = static_cast<uint32_t>(members.size()) - symbol.firstMember;
+		symbols.push_back(symbol);
+	}
+
+	bool Write(const std::wstring& path) const {
+		if (overflowed) {
+			std::wcerr << L"The database exceeds the 4 GiB of strings or 2^32 records its 32-bit offsets can address" << std::endl;
+			return false;
+		}
+
+		// Both indexes are sorted by key, ties in symbol order. The address index holds the
+		// functions and variables that cover an address range, each linked to its enclosing entry.
+		std::vector<PdbDbIndexEntry> nameIndex;
+		std::vector<PdbDbAddressEntry> addressIndex;
+		nameIndex.reserve(symbols.size());
+		for (uint32_t i = 0; i < symbols.size(); i++) {
+			const PdbDbSymbol& symbol = symbols[i];
+			const char* name = strings.data() + symbol.name;
+			nameIndex.push_back(PdbDbIndexEntry{ PdbDbHashName(name, strlen(name)), i, 0 });
+			if ((symbol.kind == PdbDbFunction || symbol.kind == PdbDbGlobal) && symbol.virtualOffset != 0 && symbol.size != 0 &&
+				symbol.size <= UINT64_MAX - symbol.virtualOffset) {
+				uint64_t rangeEnd = symbol.virtualOffset + symbol.size;
+				addressIndex.push_back(PdbDbAddressEntry{ symbol.virtualOffset, rangeEnd, i, PdbDbNoEntry });
+			}
+		}
+		std::sort(nameIndex.begin(), nameIndex.end(), [](const PdbDbIndexEntry& a, const PdbDbIndexEntry& b) {
+			return a.key < b.key || (a.key == b.key && a.symbol < b.symbol);
+		});
+		std::sort(addressIndex.begin(), addressIndex.end(), [](const PdbDbAddressEntry& a, const PdbDbAddressEntry& b) {
+			return a.start < b.start || (a.start == b.start && a.symbol < b.symbol);
+		});
+		// Starts only grow, so a range that ends at or below one start is closed for all later ones
+		// and the open ranges form a stack whose top is the latest one still open
+		std::vector<uint32_t> openRanges;
+		for (uint32_t i = 0; i < addressIndex.size(); i++) {
+			while (!openRanges.empty() && addressIndex[openRanges.back()].end <= addressIndex[i].start)
+				openRanges.pop_back();
+			if (!openRanges.empty())
+				addressIndex[i].enclosing = openRanges.back();
+			openRanges.push_back(i);
+		}
+
+		// Sections follow the header in order, each starting on an 8-byte boundary
+		PdbDbHeader header = {};
+		memcpy(header.magic, PdbDbMagic, sizeof(header.magic));
+		header.version = PdbDbVersion;
+		header.headerSize = sizeof(PdbDbHeader);
+		uint64_t offset = sizeof(PdbDbHeader);
+		auto place = [&](PdbDbSection& section, size_t count, size_t recordSize) {
+			section.offset = offset;
+			section.count = count;
+			offset = (offset + count * recordSize + 7) & ~7ULL;
+		};
+		place(header.strings, strings.size(), 1);
+		place(header.types, types.size(), sizeof(PdbDbType));
+		place(header.symbols, symbols.size(), sizeof(PdbDbSymbol));
+		place(header.members, members.size(), sizeof(PdbDbMember));
+		place(header.nameIndex, nameIndex.size(), sizeof(PdbDbIndexEntry));
+		place(header.addressIndex, addressIndex.size(), sizeof(PdbDbAddressEntry));
+
+		std::wstring partialPath = path + L".partial";
+		std::ofstream file(std::filesystem::path(partialPath), std::ios::binary);
+		auto write = [&](const PdbDbSection& section, const void* data, size_t bytes) {
+			static const char padding[8] = {};
+			file.write(padding, static_cast<std::streamsize>(section.offset - file.tellp()));
+			file.write(static_cast<const char*>(data), bytes);
+		};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		write(header.strings, strings.data(), strings.size());
+		write(header.types, types.data(), types.size() * sizeof(PdbDbType));
+		write(header.symbols, symbols.data(), symbols.size() * sizeof(PdbDbSymbol));
+		write(header.members, members.data(), members.size() * sizeof(PdbDbMember));
+		write(header.nameIndex, nameIndex.data(), nameIndex.size() * sizeof(PdbDbIndexEntry));
+		write(header.addressIndex, addressIndex.data(), addressIndex.size() * sizeof(PdbDbAddressEntry));
+		file.close();
+
+		std::error_code ec;
+		if (file)
+			std::filesystem::rename(partialPath, path, ec);
+		if (!file || ec) {
+			std::filesystem::remove(partialPath, ec);
+			return false;
+		}
+		return true;
+	}
+
+private:
+	uint32_t AddString(const std::string& text) {
+		if (text.empty())
+			return 0;
+		auto it = stringOffsets.find(text);
+		if (it != stringOffsets.end())
+			return it->second;
+		if (strings.size() + text.size() + 1 > UINT32_MAX) {
+			SetOverflowed();
+			return 0;
+		}
+
+		uint32_t offset = static_cast<uint32_t>(strings.size());
+		strings.append(text);
+		strings.push_back('\0');
+		stringOffsets.emplace(text, offset);
+		return offset;
+	}
+
+	// Index of the type named under `key`, with the "<key>Id" of --type-descriptors if present
+	uint32_t AddType(const json& record, const char* key) {
+		auto name = record.find(key);
+		if (name == record.end() || !name->is_string())
+			return PdbDbNoType;
+
+		uint32_t nameOffset = AddString(name->get_ref<const std::string&>());
+		uint64_t typeId = GetRecordNumber<uint64_t>(record, (std::string(key) + "Id").c_str());
+		auto it = typeIndexes.find(std::make_pair(nameOffset, typeId));
+		if (it != typeIndexes.end())
+			return it->second;
+
+		if (types.size() >= PdbDbNoType) {
+			SetOverflowed();
+			return PdbDbNoType;
+		}
+		uint32_t index = static_cast<uint32_t>(types.size());
+		types.push_back(PdbDbType{ nameOffset, 0, typeId });
+		typeIndexes.emplace(std::make_pair(nameOffset, typeId), index);
+		return index;
+	}
+
+	static uint32_t GetFlags(const json& record) {
+		uint32_t flags = 0;
+		if (GetRecordFlag(record, "IsVirtual"))
+			flags |= PdbDbIsVirtual;
+		if (GetRecordFlag(record, "IsPureVirtual"))
+			flags |= PdbDbIsPureVirtual;
+		if (GetRecordFlag(record, "IsStatic"))
+			flags |= PdbDbIsStatic;
+		if (GetRecordFlag(record, "IsConst"))
+			flags |= PdbDbIsConst;
+		if (record.contains("BitPosition") || record.contains("BitWidth"))
+			flags |= PdbDbIsBitField;
+		if (record.contains("VirtualTableOffset"))
+			flags |= PdbDbHasVirtualSlot;
+		return flags;
+	}
+
+	PdbDbMember& AddMember(PdbDbMemberKind kind, const json& member) {
+		PdbDbMember entry = {};
+		entry.kind = kind;
+		entry.name = AddString(GetRecordString(member, "Name"));
+		entry.type = AddType(member, "Type");
+		entry.flags = GetFlags(member);
+		entry.offset = GetRecordNumber<int64_t>(member, "Offset");
+		entry.virtualOffset = GetRecordNumber<uint64_t>(member, "VirtualOffset");
+		entry.bitPosition = GetRecordNumber<uint32_t>(member, "BitPosition");
+		entry.bitWidth = GetRecordNumber<uint32_t>(member, "BitWidth");
+		entry.virtualTableOffset = GetRecordNumber<uint32_t>(member, "VirtualTableOffset");
+		members.push_back(entry);
+		return members.back();
+	}
+
+	// Drops what was collected, since it can't be written anyway
+	void SetOverflowed() {
+		overflowed = true;
+		std::string().swap(strings);
+		stringOffsets.clear();
+		std::vector<PdbDbType>().swap(types);
+		typeIndexes.clear();
+		std::vector<PdbDbSymbol>().swap(symbols);
+		std::vector<PdbDbMember>().swap(members);
+	}
+
+	struct TypeKeyHash {
+		size_t operator()(const std::pair<uint32_t, uint64_t>& key) const {
+			return std::hash<uint64_t>()(key.second * 31 + key.first);
+		}
+	};
+
+	bool overflowed = false;
+	std::string strings;
+	std::unordered_map<std::string, uint32_t> stringOffsets;
+	std::vector<PdbDbType> types;
+	std::unordered_map<std::pair<uint32_t, uint64_t>, uint32_t, TypeKeyHash> typeIndexes; // Name offset and type ID to index
+	std::vector<PdbDbSymbol> symbols;
+	std::vector<PdbDbMember> members;
+};
+
+// Template-aware name interner. Names are parsed into a shared tree: each node is a text segment,
+// its optional template argument list and the remainder of the name (e.g. "::iterator").
+// Nodes are hash-consed, so identical subtrees such as "std::char_traits<char>" exist once and
+// structural equality is node ID equality.
+class TemplateNameInterner {
+public:
+	typedef DWORD NodeId;
+	static const NodeId InvalidNode = 0;
+
+	// Parses and interns a name; names that don't parse cleanly are interned as a single text node
+	NodeId Intern(const std::wstring& name);
+
+	// Original spelling of a node
+	std::wstring Render(NodeId id);
+
+	// Spelling with well-known aliases applied and defaulted template arguments dropped
+	std::wstring RenderCanonical(NodeId id);
+
+	size_t GetNodeCount();
+	size_t GetInternedBytes() { return internedBytes; }
+	size_t GetRequestedBytes() { return requestedBytes; }
+
+private:
+	struct Node {
+		const std::wstring* text = nullptr; // Shared text segment, owned by `texts`
+		bool hasArgs = false;
+		bool spaceBeforeClose = false;      // MSVC spells nested lists as "<...> >"
+		std::vector<NodeId> args;
+		NodeId rest = InvalidNode;
+	};
+
+	struct NodeKeyHash {
+		size_t operator()(const Node& node) const;
+	};
+	struct NodeKeyEqual {
+		bool operator()(const Node& a, const Node& b) const;
+	};
+
+	NodeId InternLocked(const std::wstring& name, size_t begin, size_t end);
+	NodeId InternNodeLocked(Node&& node);
+	NodeId InternTextLocked(const std::wstring& text);
+	void RenderLocked(NodeId id, std::wstring& out);
+	const std::wstring& RenderCanonicalLocked(NodeId id);
+	bool IsDefaultArgumentLocked(const std::wstring& templateName, size_t argIndex, const Node& node);
+
+	std::mutex mutex;
+	std::unordered_set<std::wstring> texts;
+	std::vector<Node> nodes{ Node() };               // Node 0 is InvalidNode
+	std::vector<std::wstring> canonicalSpellings{ std::wstring() };
+	std::vector<bool> canonicalComputed{ true };
+	std::unordered_map<Node, NodeId, NodeKeyHash, NodeKeyEqual> nodeIds;
+	std::unordered_map<std::wstring, NodeId> nameIds;
+	std::vector<std::pair<NodeId, const wchar_t*>> aliasIds; // Well-known aliases, interned on first use
+	size_t internedBytes = 0;
+	size_t requestedBytes = 0;
+};
+
+// Names of one PDB, shared by all of its sessions. A dump owns its pools, so that batch runs
+// don't keep the names of every PDB they have seen; nothing interned may outlive the dump.
+struct NamePools {
+	StringPool strings;
+	TemplateNameInterner templateNames;
+};
+
+// Pool statistics summed over every PDB dumped, for --stats
+struct NamePoolStats {
+	std::mutex mutex;
+	size_t distinctCount = 0;
+	ULONGLONG useCount = 0;
+	ULONGLONG usedBytes = 0;
+	ULONGLONG storedBytes = 0;
+	size_t templateNodeCount = 0;
+	size_t templateInternedBytes = 0;
+	size_t templateRequestedBytes = 0;
+
+	void Add(NamePools& pools) {
+		size_t poolDistinctCount = 0;
+		ULONGLONG poolUseCount = 0, poolUsedBytes = 0, poolStoredBytes = 0;
+		pools.strings.GetStats(poolDistinctCount, poolUseCount, poolUsedBytes, poolStoredBytes);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		distinctCount += poolDistinctCount;
+		useCount += poolUseCount;
+		usedBytes += poolUsedBytes;
+		storedBytes += poolStoredBytes;
+		templateNodeCount += pools.templateNames.GetNodeCount();
+		templateInternedBytes += pools.templateNames.GetInternedBytes();
+		templateRequestedBytes += pools.templateNames.GetRequestedBytes();
+	}
+};
+NamePoolStats namePoolStats;
+
+// Bump when the output format changes, so that dumps and record files of older versions are
+// no longer reused
+const unsigned OutputFormatVersion = 5;
+
+// Hash of everything that changes the dump of a given PDB
+ULONGLONG GetOutputOptionsHash(const SymbolFilter& filter) {
+	ULONGLONG values[] = {
+		OutputFormatVersion,
+		dumpOptions.emitTypeDescriptors,
+		dumpOptions.templateAliases,
+		dumpOptions.flattenLayout,
+		dumpOptions.dedupClasses,
+		dumpOptions.kinds,
+		dumpOptions.fields,
+		filter.GetFingerprint(),
+	};
+	ULONGLONG hash = HashBytes(values, sizeof(values));
+	for (const std::wstring& rootName : dumpOptions.rootNames)
+		hash = HashBytes(rootName.c_str(), (rootName.size() + 1) * sizeof(wchar_t), hash);
+	return hash;
+}
+
+// Finished dumps kept in --cache DIR, named after the PDB's GUID and age (as in a symbol store)
+// and a hash of the options that shape the output. A dump of a PDB that was seen before with the
+// same options is copied to the output path without extracting anything. Entries are copied rather
+// than hard-linked both ways, so that neither a dump written over later nor a cached file can
+// change the other. Entries are files in one directory; their write time records their last use, and the
+// least recently used ones are deleted when the directory grows past --cache-limit. Hit, miss and
+// eviction counts accumulate in cache-stats.txt.
+class DumpCache {
+public:
+	// Cache file for this PDB and the current options, or an empty string if the PDB has no GUID
+	std::wstring GetEntryPath(IDiaSymbol* pGlobal, const SymbolFilter& filter) {
+		GUID guid = {};
+		DWORD age = 0;
+		if (pGlobal->get_guid(&guid) != S_OK || pGlobal->get_age(&age) != S_OK)
+			return std::wstring();
+
+		wchar_t name[96];
+		swprintf(name, sizeof(name) / sizeof(name[0]), L"%08lX%04hX%04hX%02X%02X%02X%02X%02X%02X%02X%02X%lX-%016llX.json",
+			static_cast<unsigned long>(guid.Data1), guid.Data2, guid.Data3, guid.Data4[0], guid.Data4[1], guid.Data4[2],
+			guid.Data4[3], guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7], static_cast<unsigned long>(age),
+			GetOutputOptionsHash(filter));
+		return (std::filesystem::path(dumpOptions.cacheDirectory) / name).wstring();
+	}
+
+	// Puts the cached dump at `outputPath` if there is one
+	bool Serve(const std::wstring& entryPath, const std::wstring& outputPath) {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::error_code ec;
+		if (!std::filesystem::is_regular_file(entryPath, ec) || !CopyComplete(entryPath, outputPath)) {
+			misses++;
+			return false;
+		}
+		std::filesystem::last_write_time(entryPath, std::filesystem::file_time_type::clock::now(), ec);
+		hits++;
+		return true;
+	}
+
+	// Adds a finished dump to the cache and evicts the least recently used entries over the limit
+	void Store(const std::wstring& outputPath, const std::wstring& entryPath) {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::error_code ec;
+		std::filesystem::create_directories(dumpOptions.cacheDirectory, ec);
+
+		if (!CopyComplete(outputPath, entryPath))
+			return;
+		std::filesystem::last_write_time(entryPath, std::filesystem::file_time_type::clock::now(), ec);
+
+		if (dumpOptions.cacheLimit != 0)
+			EvictLocked();
+	}
+
+	// Adds this run's counts to cache-stats.txt
+	void SaveStats() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (hits == 0 && misses == 0 && evictions == 0)
+			return;
+
+		ULONGLONG totals[3] = {};
+		ReadStatsLocked(totals);
+		totals[0] += hits;
+		totals[1] += misses;
+		totals[2] += evictions;
+		hits = misses = evictions = 0;
+
+		std::ofstream statsFile(GetStatsPath());
+		statsFile << "hits " << totals[0] << "\nmisses " << totals[1] << "\nevictions " << totals[2] << "\n";
+	}
+
+	// --cache-stats
+	int PrintStats() {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<Entry> entries;
+		ULONGLONG totalBytes = 0;
+		if (!ListEntriesLocked(entries, totalBytes)) {
+			std::wcerr << L"Failed to list " << dumpOptions.cacheDirectory << std::endl;
+			return 1;
+		}
+
+		ULONGLONG totals[3] = {};
+		ReadStatsLocked(totals);
+		std::wcout << L"Cache " << dumpOptions.cacheDirectory << L": " << entries.size() << L" dumps, "
+			<< totalBytes / (1024 * 1024) << L" MB";
+		if (dumpOptions.cacheLimit != 0)
+			std::wcout << L" of " << dumpOptions.cacheLimit / (1024 * 1024) << L" MB";
+		std::wcout << std::endl;
+		std::wcout << totals[0] << L" hits, " << totals[1] << L" misses";
+		if (totals[0] + totals[1] != 0)
+			std::wcout << L" (" << std::fixed << std::setprecision(1) << 100.0 * totals[0] / (totals[0] + totals[1]) << L"% hit rate)";
+		std::wcout << L", " << totals[2] << L" evicted" << std::endl;
+		return 0;
+	}
+
+private:
+	struct Entry {
+		std::filesystem::path path;
+		std::filesystem::file_time_type lastUse;
+		ULONGLONG size;
+	};
+
+	// Copies `from` to a partial file next to `to` and renames it into place, so concurrent runs
+	// never see half a file under the final name
+	static bool CopyComplete(const std::wstring& from, const std::wstring& to) {
+		std::error_code ec;
+		std::wstring partialPath = to + L".partial";
+		if (!std::filesystem::copy_file(from, partialPath, std::filesystem::copy_options::overwrite_existing, ec) || ec) {
+			std::filesystem::remove(partialPath, ec);
+			return false;
+		}
+		std::filesystem::rename(partialPath, to, ec);
+		if (ec) {
+			std::filesystem::remove(partialPath, ec);
+			return false;
+		}
+		return true;
+	}
+
+	std::filesystem::path GetStatsPath() const {
+		return std::filesystem::path(dumpOptions.cacheDirectory) / L"cache-stats.txt";
+	}
+
+	void ReadStatsLocked(ULONGLONG (&totals)[3]) {
+		std::ifstream statsFile(GetStatsPath());
+		std::string key;
+		ULONGLONG value = 0;
+		while (statsFile >> key >> value) {
+			if (key == "hits")
+				totals[0] = value;
+			else if (key == "misses")
+				totals[1] = value;
+			else if (key == "evictions")
+				totals[2] = value;
+		}
+	}
+
+	bool ListEntriesLocked(std::vector<Entry>& entries, ULONGLONG& totalBytes) {
+		std::error_code ec;
+		totalBytes = 0;
+		for (std::filesystem::directory_iterator it(dumpOptions.cacheDirectory, ec), end; !ec && it != end; it.increment(ec)) {
+			if (it->path().extension() != L".json" || !it->is_regular_file(ec))
+				continue;
+			Entry entry{ it->path(), it->last_write_time(ec), it->file_size(ec) };
+			totalBytes += entry.size;
+			entries.push_back(std::move(entry));
+		}
+		return !ec;
+	}
+
+	void EvictLocked() {
+		std::vector<Entry> entries;
+		ULONGLONG totalBytes = 0;
+		if (!ListEntriesLocked(entries, totalBytes) || totalBytes <= dumpOptions.cacheLimit)
+			return;
+
+		std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+		for (const Entry& entry : entries) {
+			if (totalBytes <= dumpOptions.cacheLimit)
+				break;
+			std::error_code ec;
+			if (std::filesystem::remove(entry.path, ec)) {
+				totalBytes -= entry.size;
+				evictions++;
+			}
+		}
+	}
+
+	std::mutex mutex;
+	ULONGLONG hits = 0;
+	ULONGLONG misses = 0;
+	ULONGLONG evictions = 0;
+};
+DumpCache dumpCache;
+
+int wmain(int argc, wchar_t* argv[]) {
+	// Split command-line arguments into switches and positional arguments
+	std::vector<std::wstring> positionalArgs;
+	SymbolFilter filter;
+	for (int i = 1; i < argc; i++) {
+		std::wstring arg = argv[i];
+		if (arg == L"--type-descriptors") {
+			dumpOptions.emitTypeDescriptors = true;
+		}
+		else if (arg == L"--template-aliases") {
+			dumpOptions.templateAliases = true;
+		}
+		else if (arg == L"--flatten-layout") {
+			dumpOptions.flattenLayout = true;
+		}
+		else if (arg == L"--batch-size" && i + 1 < argc) {
+			dumpOptions.enumerationBatchSize = wcstoul(argv[++i], NULL, 10);
+		}
+		else if (arg == L"--threads" && i + 1 < argc) {
+			dumpOptions.threadCount = wcstoul(argv[++i], NULL, 10);
+		}
+		else if (arg == L"--batch" && i + 1 < argc) {
+			dumpOptions.batchSource = argv[++i];
+		}
+		else if (arg == L"--output-dir" && i + 1 < argc) {
+			dumpOptions.outputDirectory = argv[++i];
+		}
+		else if (arg == L"--max-open" && i + 1 < argc) {
+			dumpOptions.maxOpenPdbs = (std::max)(1ul, wcstoul(argv[++i], NULL, 10));
+		}
+		else if (arg == L"--memory-budget" && i + 1 < argc) {
+			dumpOptions.memoryBudget = wcstoull(argv[++i], NULL, 10) * 1024 * 1024;
+		}
+		else if (arg == L"--include" && i + 1 < argc) {
+			filter.AddFileRule(argv[++i], false);
+		}
+		else if (arg == L"--exclude" && i + 1 < argc) {
+			filter.AddFileRule(argv[++i], true);
+		}
+		else if (arg == L"--include-name" && i + 1 < argc) {
+			if (!filter.AddNameRule(argv[++i], false))
+				return 1;
+		}
+		else if (arg == L"--exclude-name" && i + 1 < argc) {
+			if (!filter.AddNameRule(argv[++i], true))
+				return 1;
+		}
+		else if (arg == L"--filter-file" && i + 1 < argc) {
+			if (!filter.LoadFileRules(argv[++i]))
+				return 1;
+		}
+		else if (arg == L"--root" && i + 1 < argc) {
+			dumpOptions.rootNames.push_back(argv[++i]);
+		}
+		else if (arg == L"--roots-file" && i + 1 < argc) {
+			if (!LoadRootNames(argv[++i], dumpOptions.rootNames))
+				return 1;
+		}
+		else if (arg == L"--keep-duplicates") {
+			dumpOptions.dedupClasses = false;
+		}
+		else if (arg == L"--stats") {
+			dumpOptions.printStats = true;
+		}
+		else if (arg == L"--cache" && i + 1 < argc) {
+			dumpOptions.cacheDirectory = argv[++i];
+		}
+		else if (arg == L"--cache-limit" && i + 1 < argc) {
+			dumpOptions.cacheLimit = wcstoull(argv[++i], NULL, 10) * 1024 * 1024;
+		}
+		else if (arg == L"--cache-stats") {
+			dumpOptions.cacheStats = true;
+		}
+		else if (arg == L"--database") {
+			dumpOptions.writeDatabase = true;
+		}
+		else if (arg == L"--symbolize" && i + 1 < argc) {
+			dumpOptions.symbolizeDatabase = argv[++i];
+		}
+		else if (arg == L"--diff" && i + 2 < argc) {
+			dumpOptions.diffOldPath = argv[++i];
+			dumpOptions.diffNewPath = argv[++i];
+		}
+		else if (arg == L"--incremental" && i + 1 < argc) {
+			dumpOptions.incrementalBase = argv[++i];
+		}
+		else if (arg == L"--kinds" && i + 1 < argc) {
+			if (!ParseProjection(argv[++i], outputKindNames, dumpOptions.kinds)) {
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if (arg == L"--fields" && i + 1 < argc) {
+			if (!ParseProjection(argv[++i], outputFieldNames, dumpOptions.fields)) {
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if (arg == L"--benchmark" && i + 1 < argc) {
+			dumpOptions.benchmarkName = argv[++i];
+		}
+		else if (arg.compare(0, 2, L"--") == 0) {
+			std::wcerr << L"Unknown option " << arg << std::endl;
+			PrintUsage();
+			return 1;
+		}
+		else {
+			positionalArgs.push_back(arg);
+		}
+	}
+
+	if (dumpOptions.cacheStats) {
+		if (dumpOptions.cacheDirectory.empty()) {
+			std::wcerr << L"--cache-stats needs --cache DIR" << std::endl;
+			return 1;
+		}
+		return dumpCache.PrintStats();
+	}
+
+	// --symbolize DB [ADDRESS-FILE] reads the addresses from the file, or from stdin
+	if (!dumpOptions.symbolizeDatabase.empty())
+		return RunSymbolize(dumpOptions.symbolizeDatabase, positionalArgs.empty() ? std::wstring() : positionalArgs[0]);
+
+	// The Types table is built from every type the extraction resolves, which reused records skip
+	if (!dumpOptions.incrementalBase.empty() && dumpOptions.emitTypeDescriptors) {
+		std::wcerr << L"--incremental is ignored with --type-descriptors" << std::endl;
+		dumpOptions.incrementalBase.clear();
+	}
+
+	// In batch and diff mode the PDBs come from the options and the only positional argument is
+	// the file prefix
+	bool pdbsFromOptions = !dumpOptions.batchSource.empty() || !dumpOptions.diffOldPath.empty();
+	if (pdbsFromOptions)
+		positionalArgs.insert(positionalArgs.begin(), std::wstring());
+
+	if (positionalArgs.empty() || (!pdbsFromOptions && positionalArgs[0].empty())) {
+		PrintUsage();
+		return 1;
+	}
+
+	// The file prefix argument is one more include rule
+	if (positionalArgs.size() >= 2) {
+		filter.AddFileRule(positionalArgs[1], false);
+	}
+
+	if (!dumpOptions.batchSource.empty())
+		return RunBatch(dumpOptions.batchSource, filter);
+
+	// Initialize COM library
+	HRESULT hr = CoInitialize(NULL);
+	if (FAILED(hr)) {
+		std::wcerr << L"CoInitialize failed" << std::endl;
+		return 1;
+	}
+
+	if (!dumpOptions.diffOldPath.empty()) {
+		int result = RunDiff(dumpOptions.diffOldPath, dumpOptions.diffNewPath, filter);
+		CoUninitialize();
+		return result;
+	}
+
+	if (!dumpOptions.benchmarkName.empty()) {
+		NamePools namePools;
+		SessionContext context;
+		context.namePools = &namePools;
+		int result = 1;
+		if (OpenPdbSession(positionalArgs[0], context)) {
+			sessionContext = &context;
+			result = RunBenchmark(dumpOptions.benchmarkName, context.pGlobal);
+			sessionContext = nullptr;
+		}
+		context.Close();
+		CoUninitialize();
+		return result;
+	}
+
+	std::wstring outputPath = (std::filesystem::path(dumpOptions.outputDirectory) / L"pdb_dump.json").wstring();
+
+	bool succeeded;
+	bool servedFromCache = false;
+	{
+		ThreadPool pool(GetDefaultThreadCount());
+		LONG symbolCount = 0;
+		succeeded = DumpPdb(positionalArgs[0], outputPath, filter, pool.GetThreadCount() > 1 ? &pool : nullptr, true, symbolCount, servedFromCache);
+	}
+	dumpCache.SaveStats();
+
+	if (!succeeded) {
+		CoUninitialize();
+		return 1;
+	}
+
+	// Reset console title
+	SetConsoleTitle(L"DumpPDB - Complete");
+
+	std::wcout << L"PDB information has been dumped to " << outputPath << (servedFromCache ? L" from the cache" : L"") << std::endl;
+
+	if (dumpOptions.printStats)
+		PrintStringPoolStats();
+
+	CoUninitialize();
+	return 0;
+}
+
+void PrintUsage() {
+	std::wcerr << L"Usage: DumpPDB.exe [options] <path-to-pdb-file> [file-prefix]" << std::endl
+		<< L"       DumpPDB.exe [options] --batch <list-file|directory> [file-prefix]" << std::endl
+		<< L"       DumpPDB.exe [options] --diff <old dump|pdb> <new dump|pdb> [file-prefix]" << std::endl
+		<< L"       DumpPDB.exe --symbolize <database> [address-file]" << std::endl
+		<< L"Options:" << std::endl
+		<< L"  --type-descriptors   Emit structured type descriptors and type ID references" << std::endl
+		<< L"  --template-aliases   Spell template names canonically (std::string, std::vector<T>, ...)" << std::endl
+		<< L"  --flatten-layout     Emit each class's complete layout including inherited members" << std::endl
+		<< L"  --batch-size N       Fetch N symbols per enumerator call (default 64)" << std::endl
+		<< L"  --threads N          Extract with N worker threads, each with its own DIA session" << std::endl
+		<< L"                       (default: one per hardware thread, at most 8)" << std::endl
+		<< L"  --batch LIST|DIR     Dump every PDB listed in a file (one path per line) or found under a" << std::endl
+		<< L"                       directory; the only positional argument is then the file prefix" << std::endl
+		<< L"  --output-dir DIR     Write dumps to DIR (batch mode: one <pdb name>.json per PDB)" << std::endl
+		<< L"  --max-open N         PDBs extracted at the same time in batch mode (default 2)" << std::endl
+		<< L"  --memory-budget MB   Spill buffered enums, functions, variables and typedefs to temporary" << std::endl
+		<< L"                       files beyond MB per PDB; classes in flight, caches and DIA sessions" << std::endl
+		<< L"                       are not counted" << std::endl
+		<< L"  --include PATTERN    Keep symbols whose source file starts with PATTERN or matches it as" << std::endl
+		<< L"                       a glob (*, **, ?); may be repeated" << std::endl
+		<< L"  --exclude PATTERN    Drop symbols whose source file matches PATTERN; may be repeated" << std::endl
+		<< L"  --include-name PAT   Keep symbols whose qualified name matches PAT: a glob (*, ?), re:REGEX" << std::endl
+		<< L"                       or ns:Namespace; may be repeated" << std::endl
+		<< L"  --exclude-name PAT   Drop symbols whose qualified name matches PAT; may be repeated" << std::endl
+		<< L"  --filter-file FILE   Read include rules, and exclude rules starting with -, from FILE" << std::endl
+		<< L"  --root NAME          Extract only the class, enum or typedef NAME (wildcards * and ?) and" << std::endl
+		<< L"                       every type it depends on; may be repeated" << std::endl
+		<< L"  --roots-file FILE    Read --root names from FILE, one per line" << std::endl
+		<< L"  --keep-duplicates    Emit every copy of a class, not just the first one with its name, size" << std::endl
+		<< L"                       and fields" << std::endl
+		<< L"  --cache DIR          Keep finished dumps in DIR, keyed by PDB GUID, age and options, and" << std::endl
+		<< L"                       serve them instead of extracting the same PDB again" << std::endl
+		<< L"  --cache-limit MB     Evict the least recently used cached dumps beyond MB (default: no limit)" << std::endl
+		<< L"  --cache-stats        Print the size and hit rate of the --cache directory and exit" << std::endl
+		<< L"  --database           Also write <dump>.pdbdb, a binary symbol database for memory-mapped" << std::endl
+		<< L"                       lookups through PDBDatabase.h; built in memory, outside --memory-budget" << std::endl
+		<< L"  --symbolize DB       Print the function or variable at each hexadecimal address of the" << std::endl
+		<< L"                       address file (or stdin), looked up in a --database file" << std::endl
+		<< L"  --diff OLD NEW       Compare the classes and enums of two dumps or PDBs and write the added," << std::endl
+		<< L"                       removed and changed ones to pdb_diff.json" << std::endl
+		<< L"  --incremental PREV   Take unchanged classes, enums and functions from the earlier dump PREV" << std::endl
+		<< L"                       (batch mode: a directory of earlier dumps) instead of extracting them" << std::endl
+		<< L"  --kinds LIST         Extract only the listed arrays: Classes, Enums, GlobalFunctions," << std::endl
+		<< L"                       GlobalVariables, Typedefs (comma-separated)" << std::endl
+		<< L"  --fields LIST        Extract only the listed keys, at every level, e.g. Name,Size,Fields" << std::endl
+		<< L"  --stats              Print string pool and template name statistics after dumping" << std::endl
+		<< L"  --benchmark NAME     Time an internal stage on the given PDB instead of dumping it" << std::endl
+		<< L"                       (enumeration, arena, transcode, projection, symbolize)" << std::endl;
+}
+
+// Totals over every PDB dumped; each PDB has pools of its own
+void PrintStringPoolStats() {
+	std::lock_guard<std::mutex> lock(namePoolStats.mutex);
+	if (namePoolStats.distinctCount == 0)
+		return;
+
+	std::wcout << L"Strings: " << namePoolStats.distinctCount << L" distinct for " << namePoolStats.useCount << L" uses, "
+		<< namePoolStats.storedBytes / 1024 << L" KiB stored for " << namePoolStats.usedBytes / 1024 << L" KiB used ("
+		<< std::fixed << std::setprecision(1) << double(namePoolStats.usedBytes) / double(namePoolStats.storedBytes) << L"x)" << std::endl;
+
+	if (dumpOptions.templateAliases) {
+		std::wcout << L"Template names: " << namePoolStats.templateNodeCount << L" shared nodes, "
+			<< namePoolStats.templateInternedBytes / 1024 << L" KiB stored for "
+			<< namePoolStats.templateRequestedBytes / 1024 << L" KiB of distinct spellings" << std::endl;
+	}
+}
+
+// Opens a DIA session on a PDB and fills in the session-wide properties of `context`
+bool OpenPdbSession(const std::wstring& pdbPath, SessionContext& context) {
+	HRESULT hr = CoCreateInstance(__uuidof(DiaSource), NULL, CLSCTX_INPROC_SERVER,
+		__uuidof(IDiaDataSource), (void**)&context.pSource);
+	if (FAILED(hr)) {
+		std::wcerr << L"CoCreateInstance failed " << std::hex << hr << std::endl;
+		return false;
+	}
+
+	// Load the PDB file
+	hr = context.pSource->loadDataFromPdb(pdbPath.c_str());
+	if (FAILED(hr)) {
+		std::wcerr << L"loadDataFromPdb failed" << std::endl;
+		return false;
+	}
+
+	hr = context.pSource->openSession(&context.pSession);
+	if (FAILED(hr)) {
+		std::wcerr << L"openSession failed" << std::endl;
+		return false;
+	}
+
+	hr = context.pSession->get_globalScope(&context.pGlobal);
+	if (FAILED(hr)) {
+		std::wcerr << L"get_globalScope failed" << std::endl;
+		return false;
+	}
+
+	context.pointerSize = GetPointerSize(context.pGlobal);
+	return true;
+}
+
+// Dumps one PDB to `outputPath` on a session owned by the calling thread, which must have
+// initialized COM. Worker sessions run on `pool` when one is given.
+bool DumpPdb(const std::wstring& pdbPath, const std::wstring& outputPath, const SymbolFilter& filter, ThreadPool* pool, bool reportProgress, LONG& symbolCount, bool& servedFromCache) {
+	// The main session counts the symbols and extracts whatever the workers leave behind
+	NamePools namePools;
+	SessionContext mainContext;
+	mainContext.namePools = &namePools;
+	if (!OpenPdbSession(pdbPath, mainContext)) {
+		mainContext.Close();
+		return false;
+	}
+
+	std::filesystem::path outputFile(outputPath);
+	if (outputFile.has_parent_path()) {
+		std::error_code ec;
+		std::filesystem::create_directories(outputFile.parent_path(), ec);
+	}
+
+	// A dump of the same PDB with the same options is served from the cache without extracting.
+	// Incremental dumps and dumps with a database bypass it, since the cache only keeps the JSON.
+	servedFromCache = false;
+	std::wstring cacheEntry;
+	if (!dumpOptions.cacheDirectory.empty() && dumpOptions.incrementalBase.empty() && !dumpOptions.writeDatabase) {
+		cacheEntry = dumpCache.GetEntryPath(mainContext.pGlobal, filter);
+		if (!cacheEntry.empty() && dumpCache.Serve(cacheEntry, outputPath)) {
+			mainContext.Close();
+			symbolCount = 0;
+			servedFromCache = true;
+			return true;
+		}
+	}
+
+	// An incremental dump reuses the records of the previous one (in batch mode, the dump of the
+	// same name in the --incremental directory) and writes its own record file for the next one.
+	// The previous records stay mapped until extraction ends and are released before the new
+	// record file replaces them, so a dump may replace its predecessor.
+	RecordStore previousRecords;
+	std::wstring recordsPath;
+	std::ofstream recordsFile;
+	if (!dumpOptions.incrementalBase.empty()) {
+		std::filesystem::path previousDump(dumpOptions.incrementalBase);
+		std::error_code ec;
+		if (std::filesystem::is_directory(previousDump, ec))
+			previousDump /= outputFile.filename();
+
+		ULONGLONG optionsHash = GetOutputOptionsHash(filter);
+		if (!previousRecords.Load(previousDump.wstring() + L".records", optionsHash))
+			std::wcerr << L"No usable records for " << previousDump.wstring() << L", extracting everything" << std::endl;
+		mainContext.previousRecords = &previousRecords;
+
+		recordsPath = outputPath + L".records";
+		recordsFile.open(std::filesystem::path(recordsPath + L".partial"), std::ios::binary);
+		if (recordsFile)
+			RecordStore::WriteHeader(recordsFile, optionsHash);
+	}
+
+	// Enumerate symbols, streaming the JSON to a temporary file as it is produced. It replaces the
+	// output only once complete, so a failed dump never leaves a truncated file behind.
+	std::wstring partialPath = outputPath + L".partial";
+	DatabaseBuilder database;
+	std::ofstream outFile(std::filesystem::path(partialPath), std::ios::binary);
+	bool succeeded = false;
+	if (outFile) {
+		sessionContext = &mainContext;
+		succeeded = EnumerateSymbols(pdbPath, mainContext, outFile, recordsFile.is_open() ? &recordsFile : nullptr,
+			dumpOptions.writeDatabase ? &database : nullptr, filter, pool, reportProgress, symbolCount);
+		sessionContext = nullptr;
+		namePoolStats.Add(namePools);
+		outFile.close();
+	}
+	mainContext.Close();
+	previousRecords.Close();
+
+	succeeded = succeeded && outFile;
+	if (succeeded) {
+		std::error_code ec;
+		std::filesystem::rename(partialPath, outputPath, ec);
+		succeeded = !ec;
+	}
+	if (!succeeded) {
+		std::error_code ec;
+		std::filesystem::remove(partialPath, ec);
+	}
+
+	// Only a complete record file replaces the previous one
+	if (recordsFile.is_open()) {
+		recordsFile.close();
+		std::error_code ec;
+		if (succeeded && recordsFile)
+			std::filesystem::rename(recordsPath + L".partial", recordsPath, ec);
+		else
+			std::filesystem::remove(recordsPath + L".partial", ec);
+		if (ec)
+			std::wcerr << L"Failed to write " << recordsPath << std::endl;
+	}
+
+	if (!succeeded) {
+		std::wcerr << L"Failed to write " << outputPath << std::endl;
+		return false;
+	}
+
+	if (dumpOptions.writeDatabase) {
+		std::filesystem::path databasePath(outputFile);
+		databasePath.replace_extension(L".pdbdb");
+		if (!database.Write(databasePath.wstring())) {
+			std::wcerr << L"Failed to write " << databasePath.wstring() << std::endl;
+			return false;
+		}
+	}
+
+	if (!cacheEntry.empty())
+		dumpCache.Store(outputPath, cacheEntry);
+	return true;
+}
+
+// Dumps many PDBs in one process. Up to --max-open PDBs are extracted at once, each on a thread
+// of its own that owns the PDB's main session and its serializer; all of them share one pool of
+// extraction threads, so the pool stays busy while a PDB is being opened or finished off.
+int RunBatch(const std::wstring& batchSource, const SymbolFilter& filter) {
+	std::vector<std::wstring> pdbPaths;
+	if (!CollectBatchInputs(batchSource, pdbPaths))
+		return 1;
+
+	if (pdbPaths.empty()) {
+		std::wcerr << L"No PDB files found in " << batchSource << std::endl;
+		return 1;
+	}
+
+	// Every PDB gets <output-dir>\<pdb name>.json; repeated names get a numeric suffix
+	std::vector<std::wstring> outputPaths;
+	std::unordered_map<std::wstring, unsigned> nameCounts;
+	for (const std::wstring& pdbPath : pdbPaths) {
+		std::wstring stem = std::filesystem::path(pdbPath).stem().wstring();
+		unsigned count = ++nameCounts[stem];
+		if (count > 1)
+			stem += L"_" + std::to_wstring(count);
+		outputPaths.push_back((std::filesystem::path(dumpOptions.outputDirectory) / (stem + L".json")).wstring());
+	}
+
+	ThreadPool pool(GetDefaultThreadCount());
+	std::atomic<size_t> nextPdb(0);
+	std::atomic<size_t> finishedPdbs(0);
+	std::atomic<size_t> failedPdbs(0);
+	std::mutex reportMutex;
+	auto batchStart = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> drivers;
+	size_t driverCount = (std::min)(static_cast<size_t>(dumpOptions.maxOpenPdbs), pdbPaths.size());
+	for (size_t driver = 0; driver < driverCount; driver++) {
+		drivers.emplace_back([&] {
+			CoInitialize(NULL);
+			for (size_t index = nextPdb++; index < pdbPaths.size(); index = nextPdb++) {
+				auto start = std::chrono::steady_clock::now();
+				LONG symbolCount = 0;
+				bool servedFromCache = false;
+				bool succeeded = DumpPdb(pdbPaths[index], outputPaths[index], filter, pool.GetThreadCount() > 1 ? &pool : nullptr, false, symbolCount, servedFromCache);
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+				if (!succeeded)
+					failedPdbs++;
+				size_t finished = ++finishedPdbs;
+
+				std::lock_guard<std::mutex> lock(reportMutex);
+				std::wcout << L"[" << finished << L"/" << pdbPaths.size() << L"] " << pdbPaths[index];
+				if (succeeded && servedFromCache) {
+					std::wcout << L": from the cache in " << std::fixed << std::setprecision(2) << seconds
+						<< L" s -> " << outputPaths[index] << std::endl;
+				}
+				else if (succeeded) {
+					std::wcout << L": " << symbolCount << L" symbols in " << std::fixed << std::setprecision(2) << seconds
+						<< L" s -> " << outputPaths[index] << std::endl;
+				}
+				else {
+					std::wcout << L": failed after " << std::fixed << std::setprecision(2) << seconds << L" s" << std::endl;
+				}
+
+				std::wstringstream titleStream;
+				titleStream << L"DumpPDB - Batch (" << finished << L"/" << pdbPaths.size() << L")";
+				SetConsoleTitle(titleStream.str().c_str());
+			}
+			CoUninitialize();
+		});
+	}
+	for (std::thread& driverThread : drivers)
+		driverThread.join();
+
+	double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+	std::wcout << L"Dumped " << pdbPaths.size() - failedPdbs << L" of " << pdbPaths.size() << L" PDBs in "
+		<< std::fixed << std::setprecision(2) << totalSeconds << L" s (" << pool.GetThreadCount() << L" threads, "
+		<< driverCount << L" open at a time)" << std::endl;
+	if (dumpOptions.printStats)
+		PrintStringPoolStats();
+	dumpCache.SaveStats();
+
+	SetConsoleTitle(L"DumpPDB - Complete");
+	return failedPdbs == 0 ? 0 : 1;
+}
+
+// Reads the PDB paths for batch mode: every *.pdb under a directory, or the lines of a list file
+// (UTF-8, blank lines and lines starting with '#' ignored)
+bool CollectBatchInputs(const std::wstring& batchSource, std::vector<std::wstring>& pdbPaths) {
+	std::error_code ec;
+	if (std::filesystem::is_directory(batchSource, ec)) {
+		for (std::filesystem::recursive_directory_iterator it(batchSource, ec), end; !ec && it != end; it.increment(ec)) {
+			std::wstring extension = it->path().extension().wstring();
+			std::transform(extension.begin(), extension.end(), extension.begin(), towlower);
+			if (extension == L".pdb" && it->is_regular_file(ec))
+				pdbPaths.push_back(it->path().wstring());
+		}
+		if (ec) {
+			std::wcerr << L"Failed to list " << batchSource << std::endl;
+			return false;
+		}
+
+		// Directory order isn't guaranteed; sort so runs are repeatable
+		std::sort(pdbPaths.begin(), pdbPaths.end());
+		return true;
+	}
+
+	std::filesystem::path listPath(batchSource);
+	std::ifstream listFile(listPath);
+	if (!listFile) {
+		std::wcerr << L"Failed to open " << batchSource << std::endl;
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(listFile, line)) {
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (line.empty() || line[0] == '#')
+			continue;
+		pdbPaths.push_back(std::filesystem::u8path(line).wstring());
+	}
+	return true;
+}
+
+// A property of a record or member that --diff compares, and the change it reports
+struct DiffProperty {
+	const char* key;
+	const char* change;
+};
+
+// What --diff compares: the size and the base classes, fields and vtable slots of classes, and
+// the underlying type and values of enums. Record hashes cover exactly these.
+const std::initializer_list<DiffProperty> ClassDiffProperties = { { "Size", "Size" } };
+const std::initializer_list<DiffProperty> BaseClassDiffProperties = { { "Offset", "BaseOffset" }, { "IsVirtual", "BaseVirtual" } };
+const std::initializer_list<DiffProperty> FieldDiffProperties = {
+	{ "Offset", "FieldOffset" }, { "Type", "FieldType" }, { "BitPosition", "FieldBitPosition" },
+	{ "BitWidth", "FieldBitWidth" }, { "IsStatic", "FieldStatic" } };
+const std::initializer_list<DiffProperty> VirtualMethodDiffProperties = {
+	{ "VirtualTableOffset", "VirtualSlot" }, { "VirtualTablePointerOffset", "VirtualTable" },
+	{ "VirtualTableBase", "VirtualTable" } };
+const std::initializer_list<DiffProperty> EnumDiffProperties = { { "UnderlyingType", "UnderlyingType" } };
+const std::initializer_list<DiffProperty> EnumValueDiffProperties = { { "Value", "Value" } };
+
+// Keys that match the members of two records: base classes, fields and enum values by name
+bool GetDiffMemberName(const json& member, std::string& key) {
+	key = member.value("Name", std::string());
+	return true;
+}
+
+// Virtual methods are matched by signature, so that overloads keep their own slots
+bool GetDiffMethodSignature(const json& method, std::string& key) {
+	if (!method.contains("VirtualTableOffset"))
+		return false;
+	key = method.value("Name", std::string()) + "(";
+	auto parameters = method.find("Parameters");
+	if (parameters != method.end() && parameters->is_array()) {
+		for (size_t i = 0; i < parameters->size(); i++) {
+			if (i > 0)
+				key += ", ";
+			key += (*parameters)[i].value("Type", std::string());
+		}
+	}
+	key += ")";
+	if (method.value("IsConst", false))
+		key += " const";
+	return true;
+}
+
+// Classes or enums of one side of --diff, keyed by name. Repeated names (anonymous types, or
+// copies kept by --keep-duplicates) get their occurrence number appended, so the n-th copy on
+// one side is compared with the n-th copy on the other.
+struct DiffIndex {
+	struct Entry {
+		std::string key;
+		const json* record = nullptr;
+		ULONGLONG hash = 0;
+	};
+
+	std::vector<Entry> entries;                        // In dump order
+	std::unordered_map<std::string, size_t> positions; // Key to index into `entries`
+
+	void Build(const json& records) {
+		if (!records.is_array())
+			return;
+
+		entries.reserve(records.size());
+		positions.reserve(records.size());
+		std::unordered_map<std::string, unsigned> nameCounts;
+		for (const json& record : records) {
+			Entry entry;
+			entry.key = record.is_object() ? record.value("Name", std::string()) : std::string();
+			unsigned count = ++nameCounts[entry.key];
+			if (count > 1)
+				entry.key += "#" + std::to_string(count);
+			entry.record = &record;
+			entry.hash = HashDiffRecord(record);
+			positions.emplace(entry.key, entries.size());
+			entries.push_back(std::move(entry));
+		}
+	}
+
+	// Hash of the properties DiffClass and DiffEnum compare, so that records which differ only
+	// in anything else (source location, methods without a vtable slot, parameter names) match
+	// without a deep comparison
+	static ULONGLONG HashDiffRecord(const json& record) {
+		ULONGLONG hash = HashBytes(nullptr, 0);
+		if (!record.is_object())
+			return hash;
+
+		hash = HashDiffProperties(record, ClassDiffProperties, hash);
+		hash = HashDiffProperties(record, EnumDiffProperties, hash);
+		hash = HashDiffMembers(record, "BaseClasses", GetDiffMemberName, BaseClassDiffProperties, hash);
+		hash = HashDiffMembers(record, "Fields", GetDiffMemberName, FieldDiffProperties, hash);
+		hash = HashDiffMembers(record, "Methods", GetDiffMethodSignature, VirtualMethodDiffProperties, hash);
+		return HashDiffMembers(record, "Values", GetDiffMemberName, EnumValueDiffProperties, hash);
+	}
+
+	// A missing property hashes as null, which is also how DiffProperties compares it
+	static ULONGLONG HashDiffProperties(const json& object, std::initializer_list<DiffProperty> properties, ULONGLONG hash) {
+		for (const DiffProperty& property : properties) {
+			auto value = object.find(property.key);
+			std::vector<std::uint8_t> packed = json::to_msgpack(value != object.end() ? *value : json());
+			hash = HashBytes(packed.data(), packed.size(), hash);
+		}
+		return hash;
+	}
+
+	static ULONGLONG HashDiffMembers(const json& record, const char* arrayKey, bool (*memberKey)(const json&, std::string&),
+		std::initializer_list<DiffProperty> properties, ULONGLONG hash) {
+		auto members = record.find(arrayKey);
+		if (members == record.end() || !members->is_array())
+			return hash;
+
+		std::string key;
+		for (const json& member : *members) {
+			if (!member.is_object() || !memberKey(member, key))
+				continue;
+			hash = HashBytes(key.c_str(), key.size() + 1, hash);
+			hash = HashDiffProperties(member, properties, hash);
+		}
+		return hash;
+	}
+};
+
+// Reports each property that differs between two records
+void DiffProperties(const json& oldRecord, const json& newRecord, const char* member, std::initializer_list<DiffProperty> properties, json& changes) {
+	for (const DiffProperty& property : properties) {
+		auto oldValue = oldRecord.find(property.key);
+		auto newValue = newRecord.find(property.key);
+		const json& oldSide = oldValue != oldRecord.end() ? *oldValue : json();
+		const json& newSide = newValue != newRecord.end() ? *newValue : json();
+		if (oldSide == newSide)
+			continue;
+
+		json change = json::object();
+		change["Kind"] = property.change;
+		if (member)
+			change["Member"] = member;
+		change["Old"] = oldSide;
+		change["New"] = newSide;
+		changes.push_back(std::move(change));
+	}
+}
+
+// Matches the members of the array `arrayKey` of two records by the key `memberKey` returns,
+// skipping members for which it returns false, and reports added, removed and changed members.
+// Members are reported in the order of the new record, removed ones after them.
+template<typename MemberKey>
+void DiffMembers(const json& oldRecord, const json& newRecord, const char* arrayKey, const char* memberKind, MemberKey memberKey,
+	std::initializer_list<DiffProperty> properties, json& changes) {
+	static const json noMembers = json::array();
+	auto oldArray = oldRecord.find(arrayKey);
+	auto newArray = newRecord.find(arrayKey);
+	const json& oldMembers = oldArray != oldRecord.end() && oldArray->is_array() ? *oldArray : noMembers;
+	const json& newMembers = newArray != newRecord.end() && newArray->is_array() ? *newArray : noMembers;
+
+	// Key every member, numbering repeated keys such as unnamed unions
+	auto keyMembers = [&](const json& members, std::vector<std::pair<std::string, const json*>>& keyed) {
+		std::unordered_map<std::string, unsigned> keyCounts;
+		for (const json& member : members) {
+			std::string key;
+			if (!member.is_object() || !memberKey(member, key))
+				continue;
+			unsigned count = ++keyCounts[key];
+			if (count > 1)
+				key += "#" + std::to_string(count);
+			keyed.emplace_back(std::move(key), &member);
+		}
+	};
+	std::vector<std::pair<std::string, const json*>> oldKeyed, newKeyed;
+	keyMembers(oldMembers, oldKeyed);
+	keyMembers(newMembers, newKeyed);
+
+	std::unordered_map<std::string, const json*> oldByKey(oldKeyed.begin(), oldKeyed.end());
+	auto addChange = [&](const char* suffix, const std::string& key, const json* oldMember, const json* newMember) {
+		json change = json::object();
+		change["Kind"] = std::string(memberKind) + suffix;
+		change["Member"] = key;
+		if (oldMember)
+			change["Old"] = *oldMember;
+		if (newMember)
+			change["New"] = *newMember;
+		changes.push_back(std::move(change));
+	};
+
+	for (const auto& [key, newMember] : newKeyed) {
+		auto oldMember = oldByKey.find(key);
+		if (oldMember == oldByKey.end()) {
+			addChange("Added", key, nullptr, newMember);
+			continue;
+		}
+		DiffProperties(*oldMember->second, *newMember, key.c_str(), properties, changes);
+		oldByKey.erase(oldMember);
+	}
+	for (const auto& [key, oldMember] : oldKeyed) {
+		if (oldByKey.count(key))
+			addChange("Removed", key, oldMember, nullptr);
+	}
+}
+
+// Layout changes of a class: size, base classes, fields and vtable slots
+json DiffClass(const json& oldClass, const json& newClass) {
+	json changes = json::array();
+	DiffProperties(oldClass, newClass, nullptr, ClassDiffProperties, changes);
+	DiffMembers(oldClass, newClass, "BaseClasses", "Base", GetDiffMemberName, BaseClassDiffProperties, changes);
+	DiffMembers(oldClass, newClass, "Fields", "Field", GetDiffMemberName, FieldDiffProperties, changes);
+	DiffMembers(oldClass, newClass, "Methods", "VirtualMethod", GetDiffMethodSignature, VirtualMethodDiffProperties, changes);
+	return changes;
+}
+
+json DiffEnum(const json& oldEnum, const json& newEnum) {
+	json changes = json::array();
+	DiffProperties(oldEnum, newEnum, nullptr, EnumDiffProperties, changes);
+	DiffMembers(oldEnum, newEnum, "Values", "Value", GetDiffMemberName, EnumValueDiffProperties, changes);
+	return changes;
+}
+
+// Compares one top-level array of two dumps. Records whose hashes match are unchanged without
+// further work; only the others are compared member by member.
+json DiffRecords(const json& oldRecords, const json& newRecords, json (*diffRecord)(const json&, const json&), size_t& deepCompared) {
+	DiffIndex oldIndex, newIndex;
+	oldIndex.Build(oldRecords);
+	newIndex.Build(newRecords);
+
+	json added = json::array();
+	json removed = json::array();
+	json changed = json::array();
+	for (const DiffIndex::Entry& entry : newIndex.entries) {
+		auto oldPosition = oldIndex.positions.find(entry.key);
+		if (oldPosition == oldIndex.positions.end()) {
+			added.push_back(entry.key);
+			continue;
+		}
+
+		const DiffIndex::Entry& oldEntry = oldIndex.entries[oldPosition->second];
+		if (oldEntry.hash == entry.hash)
+			continue;
+
+		deepCompared++;
+		json changes = diffRecord(*oldEntry.record, *entry.record);
+		if (!changes.empty()) {
+			json changedObject = json::object();
+			changedObject["Name"] = entry.key;
+			changedObject["Changes"] = std::move(changes);
+			changed.push_back(std::move(changedObject));
+		}
+	}
+	for (const DiffIndex::Entry& oldEntry : oldIndex.entries) {
+		if (!newIndex.positions.count(oldEntry.key))
+			removed.push_back(oldEntry.key);
+	}
+
+	json result = json::object();
+	result["Added"] = std::move(added);
+	result["Removed"] = std::move(removed);
+	result["Changed"] = std::move(changed);
+	return result;
+}
+
+// Reads the Classes and Enums of a dump for --diff; a PDB is dumped first, to `dumpPath`
+bool LoadDiffInput(const std::wstring& path, const std::wstring& dumpPath, const SymbolFilter& filter, ThreadPool* pool, json& dump) {
+	std::wstring jsonPath = path;
+	std::wstring extension = std::filesystem::path(path).extension().wstring();
+	std::transform(extension.begin(), extension.end(), extension.begin(), towlower);
+	if (extension == L".pdb") {
+		LONG symbolCount = 0;
+		bool servedFromCache = false;
+		if (!DumpPdb(path, dumpPath, filter, pool, true, symbolCount, servedFromCache))
+			return false;
+		jsonPath = dumpPath;
+	}
+
+	std::ifstream file(std::filesystem::path(jsonPath), std::ios::binary);
+	if (!file) {
+		std::wcerr << L"Failed to open " << jsonPath << std::endl;
+		return false;
+	}
+
+	// The other top-level arrays are dropped while parsing
+	json::parser_callback_t keepClassesAndEnums = [](int depth, json::parse_event_t event, json& parsed) {
+		return !(depth == 1 && event == json::parse_event_t::key && parsed != "Classes" && parsed != "Enums");
+	};
+	dump = json::parse(file, keepClassesAndEnums, false);
+	if (dump.is_discarded() || !dump.is_object()) {
+		std::wcerr << L"Failed to parse " << jsonPath << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// --diff: reports the classes and enums added, removed or changed between two dumps (or PDBs,
+// dumped first with the current options) to pdb_diff.json. Changes are the ones that matter for
+// binary compatibility: sizes, base class and field offsets, field types, vtable slots and
+// enum values.
+int RunDiff(const std::wstring& oldPath, const std::wstring& newPath, const SymbolFilter& filter) {
+	std::filesystem::path outputDirectory(dumpOptions.outputDirectory);
+	json oldDump, newDump;
+	{
+		ThreadPool pool(GetDefaultThreadCount());
+		ThreadPool* extractionPool = pool.GetThreadCount() > 1 ? &pool : nullptr;
+		if (!LoadDiffInput(oldPath, (outputDirectory / L"pdb_diff_old.json").wstring(), filter, extractionPool, oldDump) ||
+			!LoadDiffInput(newPath, (outputDirectory / L"pdb_diff_new.json").wstring(), filter, extractionPool, newDump))
+			return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	static const json noRecords = json::array();
+	auto records = [&](const json& dump, const char* key) -> const json& {
+		auto it = dump.find(key);
+		return it != dump.end() ? *it : noRecords;
+	};
+
+	size_t deepCompared = 0;
+	json report = json::object();
+	report["Old"] = WStringToString(oldPath);
+	report["New"] = WStringToString(newPath);
+	report["Classes"] = DiffRecords(records(oldDump, "Classes"), records(newDump, "Classes"), DiffClass, deepCompared);
+	report["Enums"] = DiffRecords(records(oldDump, "Enums"), records(newDump, "Enums"), DiffEnum, deepCompared);
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::filesystem::path reportPath = outputDirectory / L"pdb_diff.json";
+	if (!dumpOptions.outputDirectory.empty()) {
+		std::error_code ec;
+		std::filesystem::create_directories(outputDirectory, ec);
+	}
+	std::ofstream reportFile(reportPath, std::ios::binary);
+	reportFile << report.dump(2);
+	reportFile.close();
+	if (!reportFile) {
+		std::wcerr << L"Failed to write " << reportPath.wstring() << std::endl;
+		return 1;
+	}
+
+	for (const char* kind : { "Classes", "Enums" }) {
+		const json& result = report[kind];
+		std::wcout << kind << L": " << result["Added"].size() << L" added, " << result["Removed"].size() << L" removed, "
+			<< result["Changed"].size() << L" changed" << std::endl;
+	}
+	std::wcout << deepCompared << L" records compared member by member in " << std::fixed << std::setprecision(2)
+		<< milliseconds << L" ms, the rest matched by hash" << std::endl;
+	std::wcout << L"Differences have been written to " << reportPath.wstring() << std::endl;
+	return 0;
+}
+
+// --symbolize: prints `<address> <symbol>+0x<offset>` for each hexadecimal address (0x prefix
+// optional) read one per line, or `<address> ?` if no function or variable covers it. The
+// addresses are looked up together, sorted, in one pass over the address index.
+int RunSymbolize(const std::wstring& databasePath, const std::wstring& addressesPath) {
+	PDBDatabase database;
+	if (!database.Open(databasePath.c_str())) {
+		std::wcerr << L"Failed to open " << databasePath << L" as a symbol database" << std::endl;
+		return 1;
+	}
+
+	std::ifstream addressesFile;
+	if (!addressesPath.empty()) {
+		addressesFile.open(std::filesystem::path(addressesPath));
+		if (!addressesFile) {
+			std::wcerr << L"Failed to open " << addressesPath << std::endl;
+			return 1;
+		}
+	}
+	std::istream& in = addressesPath.empty() ? std::cin : addressesFile;
+
+	std::vector<uint64_t> addresses;
+	std::string line;
+	while (std::getline(in, line)) {
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (!line.empty())
+			addresses.push_back(strtoull(line.c_str(), NULL, 16));
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<uint32_t> symbols(addresses.size());
+	database.FindByAddresses(addresses.data(), addresses.size(), symbols.data());
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::string text;
+	char number[32];
+	for (size_t i = 0; i < addresses.size(); i++) {
+		snprintf(number, sizeof(number), "0x%llX ", static_cast<unsigned long long>(addresses[i]));
+		text += number;
+		if (symbols[i] == PDBDatabase::NotFound) {
+			text += "?\n";
+		}
+		else {
+			const PdbDbSymbol& symbol = database.GetSymbol(symbols[i]);
+			text += database.GetString(symbol.name);
+			snprintf(number, sizeof(number), "+0x%llX\n", static_cast<unsigned long long>(addresses[i] - symbol.virtualOffset));
+			text += number;
+		}
+		if (text.size() >= 1024 * 1024) {
+			std::cout.write(text.data(), text.size());
+			text.clear();
+		}
+	}
+	std::cout.write(text.data(), text.size());
+	std::cout.flush();
+
+	std::wcerr << L"Looked up " << addresses.size() << L" addresses in " << std::fixed << std::setprecision(2)
+		<< milliseconds << L" ms" << std::endl;
+	return std::cout ? 0 : 1;
+}
+
+// Extracts all top-level symbols and writes them to `out` as a pipeline:
+//  - worker threads, each with its own DIA session, enumerate chunks of the symbol list and
+//    resolve their types into JSON, taking chunks from work-stealing queues;
+//  - a serializer thread turns finished chunks into text in chunk order, so the output is
+//    identical to a single-threaded run;
+//  - a writer thread writes the text while the other stages keep going.
+// Each stage waits on the next one through a bounded buffer, so memory stays flat and the wall
+// time approaches that of the slowest stage. The output matches json::dump(2) of the whole dump.
+// Workers run as jobs on `pool`; without a pool this thread does all of the extraction.
+bool EnumerateSymbols(const std::wstring& pdbPath, SessionContext& mainContext, std::ostream& out, std::ostream* recordsOut, DatabaseBuilder* database, const SymbolFilter& filter, ThreadPool* pool, bool reportProgress, LONG& symbolCount) {
+	HRESULT hr;
+	CComPtr<IDiaEnumSymbols> pEnumSymbols;
+	std::vector<CComPtr<IDiaSymbol>> reachableTypes;
+	LONG totalSymbols = 0;
+
+	if (!dumpOptions.rootNames.empty()) {
+		// Only the types reachable from the roots are extracted
+		auto start = std::chrono::steady_clock::now();
+		CollectReachableTypes(mainContext, filter, reachableTypes);
+		totalSymbols = static_cast<LONG>(reachableTypes.size());
+		if (reportProgress) {
+			std::wcout << totalSymbols << L" types reachable from " << dumpOptions.rootNames.size() << L" roots, found in "
+				<< std::fixed << std::setprecision(1) << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+				<< L" ms" << std::endl;
+		}
+	}
+	else {
+		// Enumerate all symbols
+		hr = mainContext.pGlobal->findChildren(GetEnumerationTag(), NULL, nsNone, &pEnumSymbols);
+		if (FAILED(hr)) {
+			std::wcerr << L"findChildren failed" << std::endl;
+			return false;
+		}
+		pEnumSymbols->get_Count(&totalSymbols);
+	}
+	symbolCount = totalSymbols;
+
+	size_t chunkCount = (static_cast<size_t>(totalSymbols) + SymbolsPerChunk - 1) / SymbolsPerChunk;
+	std::vector<SymbolArrays> chunkResults(chunkCount);
+	std::atomic<LONG> processedSymbols(0);
+	double lastProgressPercentage = -1.0; // Initialize to -1 to ensure the first update
+
+	// Reachable types are symbols of the main session, so their extraction stays on this thread
+	size_t workerCount = pool && dumpOptions.rootNames.empty() ? pool->GetThreadCount() : 1;
+	workerCount = (std::max)((std::min)(workerCount, chunkCount), size_t(1));
+
+	ClassDedupTable classDedup;
+	mainContext.classDedup = dumpOptions.dedupClasses ? &classDedup : nullptr;
+
+	std::vector<const SessionContext*> contexts{ &mainContext };
+	std::vector<std::unique_ptr<SessionContext>> workerContexts;
+	WorkStealingQueues queues(workerCount);
+	ChunkReorderBuffer reorderBuffer(chunkCount, workerCount * 4);
+
+	// Contiguous ranges per worker keep each session's caches warm for neighbouring symbols
+	for (size_t chunk = 0; chunk < chunkCount; chunk++)
+		queues.Push(chunk * workerCount / chunkCount, chunk);
+
+	// Extraction loop shared by the workers and the main thread
+	auto extractChunks = [&](size_t worker, IDiaEnumSymbols* pSymbols, bool updateProgress) {
+		for (;;) {
+			size_t limit = reorderBuffer.GetLimit();
+			size_t chunk = 0;
+			WorkStealingQueues::PopResult result = queues.Pop(worker, limit, chunk);
+			if (result == WorkStealingQueues::PopEmpty)
+				break;
+			if (result == WorkStealingQueues::PopBlocked) {
+				reorderBuffer.WaitForLimitAbove(limit);
+				continue;
+			}
+
+			if (pSymbols)
+				ProcessChunk(pSymbols, chunk, totalSymbols, chunkResults[chunk], filter, processedSymbols);
+			else
+				ProcessChunk(reachableTypes, chunk, chunkResults[chunk], filter, processedSymbols);
+			reorderBuffer.MarkReady(chunk);
+			if (updateProgress)
+				UpdateProgress(processedSymbols, totalSymbols, lastProgressPercentage);
+		}
+	};
+
+	// Writer stage. The file is opened in binary mode, so line breaks are written as CRLF here,
+	// as a text-mode stream does on Windows; JSON strings never contain a raw line break.
+	BoundedQueue<std::string> writeQueue(16);
+	std::thread writer([&] {
+		std::string text;
+		while (writeQueue.Pop(text)) {
+			size_t start = 0;
+			for (size_t newline; (newline = text.find('\n', start)) != std::string::npos; start = newline + 1) {
+				out.write(text.data() + start, newline - start);
+				out.write("\r\n", 2);
+			}
+			out.write(text.data() + start, text.size() - start);
+		}
+	});
+
+	// Serializer stage. Classes come first in the output and are streamed straight through; the
+	// other kinds are spooled, spilling to disk past --memory-budget, and follow once every chunk
+	// is serialized.
+	bool spoolsRead = true;
+	size_t recordCount = 0;
+	std::thread serializer([&] {
+		KindSpool spool;
+		writeQueue.Push("{\n  \"Classes\": [");
+
+		size_t chunk = 0;
+		while (reorderBuffer.WaitForNext(chunk)) {
+			std::string classesText;
+			SymbolArrays& arrays = chunkResults[chunk];
+			size_t droppedClasses = SerializeChunk(arrays, classesText, spool, recordsOut, database);
+			classDedup.AddDuplicates(droppedClasses);
+			recordCount += arrays.classHashes.size() - (arrays.classHashes.empty() ? 0 : droppedClasses) + arrays.enumHashes.size() + arrays.functionHashes.size();
+			chunkResults[chunk] = SymbolArrays();
+			reorderBuffer.Release(chunk);
+			if (!classesText.empty())
+				writeQueue.Push(std::move(classesText));
+			spool.EnforceBudget(dumpOptions.memoryBudget);
+		}
+
+		writeQueue.Push(spool.firstClass ? "]" : "\n  ]");
+		spoolsRead = WriteSpooledArray(writeQueue, "Enums", spool.enums) &&
+			WriteSpooledArray(writeQueue, "GlobalFunctions", spool.functions) &&
+			WriteSpooledArray(writeQueue, "GlobalVariables", spool.globals) &&
+			WriteSpooledArray(writeQueue, "Typedefs", spool.typedefs);
+
+		if (reportProgress && spool.GetSpilledBytes() > 0)
+			std::wcout << L"Spilled " << spool.GetSpilledBytes() / 1024 << L" KiB of output to disk" << std::endl;
+	});
+
+	if (workerCount > 1) {
+		CompletionLatch workersDone(workerCount);
+		for (size_t worker = 0; worker < workerCount; worker++) {
+			workerContexts.emplace_back(new SessionContext);
+			workerContexts.back()->classDedup = mainContext.classDedup;
+			workerContexts.back()->previousRecords = mainContext.previousRecords;
+			workerContexts.back()->namePools = mainContext.namePools;
+			contexts.push_back(workerContexts.back().get());
+		}
+
+		for (size_t worker = 0; worker < workerCount; worker++) {
+			pool->Submit([&, worker] {
+				SessionContext& context = *workerContexts[worker];
+				if (OpenPdbSession(pdbPath, context)) {
+					sessionContext = &context;
+
+					// A worker whose session sees a different symbol list leaves its chunks to the others
+					CComPtr<IDiaEnumSymbols> pWorkerSymbols;
+					LONG workerTotal = 0;
+					if (SUCCEEDED(context.pGlobal->findChildren(GetEnumerationTag(), NULL, nsNone, &pWorkerSymbols)) &&
+						SUCCEEDED(pWorkerSymbols->get_Count(&workerTotal)) && workerTotal == totalSymbols) {
+						extractChunks(worker, pWorkerSymbols, false);
+					}
+					pWorkerSymbols.Release();
+					sessionContext = nullptr;
+				}
+				context.Close();
+				workersDone.CountDown();
+			});
+		}
+
+		// Progress is reported from this thread only
+		while (!workersDone.WaitFor(std::chrono::milliseconds(100))) {
+			if (reportProgress)
+				UpdateProgress(processedSymbols, totalSymbols, lastProgressPercentage);
+		}
+	}
+
+	// Single-threaded run, or chunks left behind by workers that couldn't open a session
+	extractChunks(0, pEnumSymbols, reportProgress);
+	serializer.join();
+
+	if (reportProgress && classDedup.GetDuplicateCount() > 0)
+		std::wcout << L"Skipped " << classDedup.GetDuplicateCount() << L" duplicate classes" << std::endl;
+	if (reportProgress && mainContext.previousRecords) {
+		std::wcout << L"Reused " << mainContext.previousRecords->GetReusedCount() << L" of " << recordCount
+			<< L" classes, enums and functions from the previous dump" << std::endl;
+	}
+
+	// Type descriptors are only complete once every chunk has been extracted
+	std::string tail;
+	if (spoolsRead && dumpOptions.emitTypeDescriptors) {
+		tail += ",\n  \"Types\": ";
+		json typesArray = BuildTypeDescriptorsArray(contexts);
+		if (typesArray.empty())
+			tail += "[]";
+		else
+			AppendIndented(tail, typesArray, 2);
+	}
+	tail += "\n}";
+	writeQueue.Push(std::move(tail));
+	writeQueue.Close();
+	writer.join();
+
+	if (!spoolsRead)
+		std::wcerr << L"Failed to read back a spool file" << std::endl;
+	return spoolsRead && static_cast<bool>(out);
+}
+
+// Serializes one chunk: classes are appended to `classesText`, everything else to the spool, and
+// with --incremental the class, enum and function records also go to `recordsOut`, and with
+// --database every record also goes to `database`.
+// Returns the number of classes dropped because an earlier duplicate took over their claim.
+size_t SerializeChunk(SymbolArrays& arrays, std::string& classesText, KindSpool& spool, std::ostream* recordsOut, DatabaseBuilder* database) {
+	size_t droppedClasses = 0;
+	for (size_t i = 0; i < arrays.classes.size(); i++) {
+		if (!arrays.classClaims.empty() && arrays.classClaims[i].entry->owner != arrays.classClaims[i].position) {
+			droppedClasses++;
+			continue;
+		}
+		AppendArrayElement(classesText, arrays.classes[i], spool.firstClass);
+		if (recordsOut && !arrays.classHashes.empty())
+			RecordStore::WriteRecord(*recordsOut, arrays.classHashes[i], arrays.classes[i]);
+		if (database)
+			database->AddSymbol(PdbDbClass, arrays.classes[i]);
+	}
+	for (size_t i = 0; i < arrays.enums.size(); i++) {
+		spool.enums.Add(arrays.enums[i]);
+		if (recordsOut && !arrays.enumHashes.empty())
+			RecordStore::WriteRecord(*recordsOut, arrays.enumHashes[i], arrays.enums[i]);
+		if (database)
+			database->AddSymbol(PdbDbEnum, arrays.enums[i]);
+	}
+	for (size_t i = 0; i < arrays.functions.size(); i++) {
+		spool.functions.Add(arrays.functions[i]);
+		if (recordsOut && !arrays.functionHashes.empty())
+			RecordStore::WriteRecord(*recordsOut, arrays.functionHashes[i], arrays.functions[i]);
+		if (database)
+			database->AddSymbol(PdbDbFunction, arrays.functions[i], arrays.functionRanges[i]);
+	}
+	for (size_t i = 0; i < arrays.globals.size(); i++) {
+		spool.globals.Add(arrays.globals[i]);
+		if (database)
+			database->AddSymbol(PdbDbGlobal, arrays.globals[i], arrays.globalRanges[i]);
+	}
+	for (const json& typedefObject : arrays.typedefs) {
+		spool.typedefs.Add(typedefObject);
+		if (database)
+			database->AddSymbol(PdbDbTypedef, typedefObject);
+	}
+	return droppedClasses;
+}
+
+// Writes `,"key": [records]` laid out as json::dump(2) would, in blocks of about 1 MiB
+bool WriteSpooledArray(BoundedQueue<std::string>& writeQueue, const char* key, RecordSpool& records) {
+	std::string text = ",\n  \"";
+	text += key;
+	text += "\": [";
+
+	bool first = true;
+	bool succeeded = records.Drain([&](const json& record) {
+		AppendArrayElement(text, record, first);
+		if (text.size() >= 1024 * 1024) {
+			writeQueue.Push(std::move(text));
+			text.clear();
+		}
+	});
+
+	text += first ? "]" : "\n  ]";
+	writeQueue.Push(std::move(text));
+	return succeeded;
+}
+
+// Appends value.dump(2) with every line after the first indented by `indent` more spaces
+void AppendIndented(std::string& out, const json& value, size_t indent) {
+	std::string text = value.dump(2);
+	for (char c : text) {
+		out += c;
+		if (c == '\n')
+			out.append(indent, ' ');
+	}
+}
+
+// Appends one element of a top-level array, laid out as json::dump(2) would
+void AppendArrayElement(std::string& out, const json& value, bool& first) {
+	out += first ? "\n    " : ",\n    ";
+	first = false;
+	AppendIndented(out, value, 4);
+}
+
+// Processes symbols [chunk * SymbolsPerChunk, (chunk + 1) * SymbolsPerChunk) of a global enumerator
+void ProcessChunk(IDiaEnumSymbols* pEnumSymbols, size_t chunk, size_t totalSymbols, SymbolArrays& arrays, const SymbolFilter& filter, std::atomic<LONG>& processedSymbols) {
+	size_t begin = chunk * SymbolsPerChunk;
+	size_t end = (std::min)(begin + SymbolsPerChunk, totalSymbols);
+
+	pEnumSymbols->Reset();
+	if (begin > 0 && FAILED(pEnumSymbols->Skip(static_cast<ULONG>(begin))))
+		return;
+
+	size_t position = begin;
+	ForEachSymbol(pEnumSymbols, [&](IDiaSymbol* pSymbol) {
+		sessionContext->symbolPosition = position++;
+		ProcessSymbol(pSymbol, arrays, filter);
+		scratchArena.Reset();
+	}, dumpOptions.enumerationBatchSize, static_cast<ULONG>(end - begin));
+
+	processedSymbols += static_cast<LONG>(end - begin);
+}
+
+// Processes symbols [chunk * SymbolsPerChunk, (chunk + 1) * SymbolsPerChunk) of a symbol list
+void ProcessChunk(const std::vector<CComPtr<IDiaSymbol>>& symbols, size_t chunk, SymbolArrays& arrays, const SymbolFilter& filter, std::atomic<LONG>& processedSymbols) {
+	size_t begin = chunk * SymbolsPerChunk;
+	size_t end = (std::min)(begin + SymbolsPerChunk, symbols.size());
+
+	for (size_t i = begin; i < end; i++) {
+		sessionContext->symbolPosition = i;
+		ProcessSymbol(symbols[i], arrays, filter);
+		scratchArena.Reset();
+	}
+
+	processedSymbols += static_cast<LONG>(end - begin);
+}
+
+void ProcessSymbol(IDiaSymbol* pSymbol, SymbolArrays& arrays, const SymbolFilter& filter) {
+	DWORD symTag = 0;
+	pSymbol->get_symTag(&symTag);
+
+	switch (symTag) {
+	case SymTagUDT:
+		if (dumpOptions.kinds & KindClasses)
+			ProcessUDT(pSymbol, arrays, filter);
+		break;
+	case SymTagEnum:
+		if (dumpOptions.kinds & KindEnums)
+			ProcessEnum(pSymbol, arrays, filter);
+		break;
+	case SymTagFunction:
+		if (dumpOptions.kinds & KindFunctions)
+			ProcessFunction(pSymbol, arrays, filter);
+		break;
+	case SymTagData:
+		if (dumpOptions.kinds & KindGlobals)
+			ProcessData(pSymbol, arrays, filter);
+		break;
+	case SymTagTypedef:
+		if (dumpOptions.kinds & KindTypedefs)
+			ProcessTypedef(pSymbol, arrays.typedefs, filter);
+		break;
+	default:
+		break;
+	}
+}
+
+// Reads --roots-file: one type name per line (UTF-8, blank lines and lines starting with '#' ignored)
+bool LoadRootNames(const std::wstring& path, std::vector<std::wstring>& rootNames) {
+	std::filesystem::path rootsPath(path);
+	std::ifstream rootsFile(rootsPath);
+	if (!rootsFile) {
+		std::wcerr << L"Failed to open " << path << std::endl;
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(rootsFile, line)) {
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (line.empty() || line[0] == '#')
+			continue;
+		rootNames.push_back(std::filesystem::u8path(line).wstring());
+	}
+	return true;
+}
+
+// Breadth-first walk from the --root types over base classes, field types, method parameter and
+// return types and typedef targets. Pointers, arrays and function signatures are looked through
+// to the class, enum or typedef they refer to. Each type is queued once, tracked by a bitset over
+// symbol IDs. Types that fail the file or name rules are neither kept nor walked further, so an
+// exclude rule cuts off everything that is only reachable through the excluded types.
+class ReachabilityWalk {
+public:
+	ReachabilityWalk(const SymbolFilter& filter, std::vector<CComPtr<IDiaSymbol>>& types)
+		: filter(filter), types(types) {
+	}
+
+	// Queues the class, enum or typedef behind `pType`, if it hasn't been seen yet
+	void Visit(IDiaSymbol* pType) {
+		CComPtr<IDiaSymbol> pCurrent = pType;
+		while (pCurrent) {
+			DWORD symTag = SymTagNull;
+			pCurrent->get_symTag(&symTag);
+			if (symTag == SymTagPointerType || symTag == SymTagArrayType) {
+				CComPtr<IDiaSymbol> pTarget;
+				if (pCurrent->get_type(&pTarget) != S_OK)
+					return;
+				pCurrent = pTarget;
+				continue;
+			}
+			if (symTag != SymTagUDT && symTag != SymTagEnum && symTag != SymTagTypedef && symTag != SymTagFunctionType)
+				return;
+
+			DWORD id = 0;
+			pCurrent->get_symIndexId(&id);
+
+			// A const or volatile class or enum is a symbol of its own; continue with the unqualified
+			// type so that each type is kept once however it is qualified
+			if (symTag == SymTagUDT || symTag == SymTagEnum) {
+				CComPtr<IDiaSymbol> pUnmodified;
+				DWORD unmodifiedId = 0;
+				if (pCurrent->get_unmodifiedType(&pUnmodified) == S_OK && pUnmodified &&
+					pUnmodified->get_symIndexId(&unmodifiedId) == S_OK && unmodifiedId != id) {
+					pCurrent = pUnmodified;
+					continue;
+				}
+			}
+
+			if (id >= visited.size())
+				visited.resize((std::max)(size_t(id) + 1, visited.size() * 2));
+			if (visited[id])
+				return;
+			visited[id] = true;
+
+			if (symTag == SymTagFunctionType) {
+				VisitSignature(pCurrent);
+				return;
+			}
+			if (!PassesFilter(pCurrent))
+				return;
+			queue.push_back(pCurrent);
+			return;
+		}
+	}
+
+	// Expands queued types until the closure is complete; kept types end up in `types` in
+	// breadth-first order
+	void Run() {
+		for (size_t head = 0; head < queue.size(); head++) {
+			IDiaSymbol* pSymbol = queue[head];
+			types.push_back(pSymbol);
+
+			DWORD symTag = SymTagNull;
+			pSymbol->get_symTag(&symTag);
+			if (symTag == SymTagTypedef) {
+				VisitType(pSymbol);
+			}
+			else if (symTag == SymTagUDT) {
+				VisitChildTypes(pSymbol, SymTagBaseClass);
+				VisitChildTypes(pSymbol, SymTagData);
+
+				CComPtr<IDiaEnumSymbols> pFunctions;
+				if (SUCCEEDED(pSymbol->findChildren(SymTagFunction, NULL, nsNone, &pFunctions))) {
+					ForEachSymbol(pFunctions, [&](IDiaSymbol* pFunction) {
+						VisitChildTypes(pFunction, SymTagFunctionArgType);
+						VisitType(pFunction);
+					});
+				}
+			}
+			scratchArena.Reset();
+		}
+		queue.clear();
+	}
+
+private:
+	void VisitType(IDiaSymbol* pSymbol) {
+		CComPtr<IDiaSymbol> pType;
+		if (pSymbol->get_type(&pType) == S_OK)
+			Visit(pType);
+	}
+
+	void VisitChildTypes(IDiaSymbol* pParent, enum SymTagEnum childTag) {
+		CComPtr<IDiaEnumSymbols> pChildren;
+		if (SUCCEEDED(pParent->findChildren(childTag, NULL, nsNone, &pChildren)))
+			ForEachSymbol(pChildren, [&](IDiaSymbol* pChild) { VisitType(pChild); });
+	}
+
+	// Return and argument types of a function type
+	void VisitSignature(IDiaSymbol* pSignature) {
+		VisitType(pSignature);
+		VisitChildTypes(pSignature, SymTagFunctionArgType);
+	}
+
+	bool PassesFilter(IDiaSymbol* pSymbol) {
+		if (filter.HasFileRules() && !PassesFileFilter(GetSourceLocation(pSymbol), filter))
+			return false;
+		if (filter.HasNameRules() && !PassesNameFilter(GetQualifiedName(pSymbol), filter))
+			return false;
+		return true;
+	}
+
+	const SymbolFilter& filter;
+	std::vector<CComPtr<IDiaSymbol>>& types;
+	std::vector<CComPtr<IDiaSymbol>> queue;
+	std::vector<bool> visited;
+};
+
+// Finds the classes, enums and typedefs named by --root and collects everything they depend on
+void CollectReachableTypes(SessionContext& context, const SymbolFilter& filter, std::vector<CComPtr<IDiaSymbol>>& types) {
+	ReachabilityWalk walk(filter, types);
+	for (const std::wstring& rootName : dumpOptions.rootNames) {
+		// DIA matches * and ? only when asked for a regular expression search
+		bool hasWildcards = rootName.find_first_of(L"*?") != std::wstring::npos;
+		bool found = false;
+		for (enum SymTagEnum symTag : { SymTagUDT, SymTagEnum, SymTagTypedef }) {
+			CComPtr<IDiaEnumSymbols> pMatches;
+			if (FAILED(context.pGlobal->findChildren(symTag, rootName.c_str(), hasWildcards ? nsRegularExpression : nsCaseSensitive, &pMatches)))
+				continue;
+			ForEachSymbol(pMatches, [&](IDiaSymbol* pMatch) {
+				found = true;
+				walk.Visit(pMatch);
+			});
+		}
+		if (!found)
+			std::wcerr << L"No class, enum or typedef named " << rootName << std::endl;
+	}
+	walk.Run();
+}
+
+void UpdateProgress(LONG processedSymbols, LONG totalSymbols, double& lastProgressPercentage) {
+	if (totalSymbols == 0)
+		return;
+
+	double progressPercentage = (static_cast<double>(processedSymbols) * 100.0) / static_cast<double>(totalSymbols);
+	// Round to one decimal place
+	progressPercentage = floor(progressPercentage * 10.0 + 0.5) / 10.0;
+
+	// Only update the title if the percentage has changed
+	if (progressPercentage != lastProgressPercentage) {
+		lastProgressPercentage = progressPercentage;
+		std::wstringstream titleStream;
+		titleStream << L"DumpPDB - Processing (" << std::fixed << std::setprecision(1) << progressPercentage << L"%)";
+		SetConsoleTitle(titleStream.str().c_str());
+	}
+}
+
+void ProcessUDT(CComPtr<IDiaSymbol> pSymbol, SymbolArrays& arrays, const SymbolFilter& filter) {
+	HRESULT hr;
+
+	json classObject = json::object();
+
+	// Get class definition file and line number. The file prefix filter runs before anything
+	// else is resolved, so skipped classes cost only this lookup.
+	const RecordStore* previousRecords = sessionContext->previousRecords;
+	SourceLocation location;
+	if (filter.HasFileRules() || EmitField(FieldSourceFile | FieldLineNumber))
+		location = GetSourceLocation(pSymbol);
+	if (!PassesFileFilter(location, filter))
+		return;
+	SetSourceLocationFields(classObject, location);
+
+	// Get class name
+	ClassDedupTable* classDedup = sessionContext->classDedup;
+	std::wstring className;
+	if (filter.HasNameRules() || EmitField(FieldName) || classDedup)
+		className = GetQualifiedName(pSymbol);
+	if (!PassesNameFilter(className, filter))
+		return;
+
+	// Get class size
+	ULONGLONG length = 0;
+	pSymbol->get_length(&length);
+
+	// A class whose record hash is unchanged since the previous dump keeps its previous record.
+	// The member hash already covers the data members, so it also yields the class key.
+	const ClassDedupTable::Entry* claim = nullptr;
+	ULONGLONG recordHash = 0;
+	if (previousRecords) {
+		ULONGLONG memberFieldHash = 0;
+		recordHash = HashClassRecord(pSymbol, className, length, location, memberFieldHash);
+		if (classDedup) {
+			ULONGLONG keyFieldHash = EmitField(FieldFields) ? memberFieldHash : 0;
+			claim = classDedup->Claim(ClassKey{ className, length, keyFieldHash }, sessionContext->symbolPosition);
+			if (!claim)
+				return;
+		}
+		if (previousRecords->Find(recordHash, classObject)) {
+			arrays.classes.push_back(std::move(classObject));
+			arrays.classHashes.push_back(recordHash);
+			if (claim)
+				arrays.classClaims.push_back(ClassClaim{ claim, sessionContext->symbolPosition });
+			return;
+		}
+	}
+
+	// Data members (fields). They are read before anything else because the class key is hashed
+	// from them on the way: a copy of a class that is already claimed costs this one walk.
+	ULONGLONG fieldHash = 0;
+	if (EmitField(FieldFields)) {
+		bool hashFields = classDedup && !claim;
+		fieldHash = HashBytes(nullptr, 0);
+		json fieldsArray = json::array();
+		CComPtr<IDiaEnumSymbols> pDataMembers;
+		hr = pSymbol->findChildren(SymTagData, NULL, nsNone, &pDataMembers);
+		if (SUCCEEDED(hr)) {
+			ForEachSymbol(pDataMembers, [&](IDiaSymbol* pDataMember) {
+				json fieldObject = json::object();
+				if (EmitField(FieldName) || hashFields) {
+					ScratchWString fieldName = GetScratchName(pDataMember);
+					if (hashFields)
+						fieldHash = HashBytes(fieldName.data(), fieldName.size() * sizeof(wchar_t), fieldHash);
+					if (EmitField(FieldName))
+						fieldObject["Name"] = WStringToString(fieldName);
+				}
+
+				// Type
+				if (EmitField(FieldType) || hashFields) {
+					CComPtr<IDiaSymbol> pType;
+					pDataMember->get_type(&pType);
+					if (hashFields) {
+						ULONGLONG typeId = GetTypeId(pType);
+						fieldHash = HashBytes(&typeId, sizeof(typeId), fieldHash);
+					}
+					if (EmitField(FieldType))
+						SetTypeField(fieldObject, "Type", pType);
+				}
+
+				// Is static
+				DWORD locationType = 0;
+				if (EmitField(FieldIsStatic | FieldBitPosition | FieldBitWidth))
+					pDataMember->get_locationType(&locationType);
+				if (EmitField(FieldIsStatic))
+					fieldObject["IsStatic"] = (locationType == LocIsStatic);
+
+				// Is const
+				if (EmitField(FieldIsConst)) {
+					BOOL isConst = FALSE;
+					pDataMember->get_constType(&isConst);
+					fieldObject["IsConst"] = isConst ? true : false;
+				}
+
+				// Offset
+				if (EmitField(FieldOffset) || hashFields) {
+					LONG offset = 0;
+					pDataMember->get_offset(&offset);
+					if (hashFields)
+						fieldHash = HashBytes(&offset, sizeof(offset), fieldHash);
+					if (EmitField(FieldOffset))
+						fieldObject["Offset"] = offset;
+				}
+
+				// Bitfield position and width; Offset is the start of the storage unit.
+				// Only bitfields pay for the extra lookups, the location type is already known.
+				if (locationType == LocIsBitField) {
+					if (EmitField(FieldBitPosition)) {
+						DWORD bitPosition = 0;
+						pDataMember->get_bitPosition(&bitPosition);
+						fieldObject["BitPosition"] = bitPosition;
+					}
+
+					if (EmitField(FieldBitWidth)) {
+						ULONGLONG bitWidth = 0;
+						pDataMember->get_length(&bitWidth);
+						fieldObject["BitWidth"] = bitWidth;
+					}
+				}
+
+				// Virtual Offset
+				if (EmitField(FieldVirtualOffset)) {
+					uintptr_t virtualAddress = 0;
+					pDataMember->get_virtualAddress((ULONGLONG*)&virtualAddress);
+					fieldObject["VirtualOffset"] = virtualAddress;
+				}
+
+				fieldsArray.push_back(std::move(fieldObject));
+			});
+		}
+		classObject["Fields"] = std::move(fieldsArray);
+	}
+
+	// Skip copies of a class that was already claimed, before any other member is resolved
+	if (classDedup && !claim) {
+		claim = classDedup->Claim(ClassKey{ className, length, fieldHash }, sessionContext->symbolPosition);
+		if (!claim)
+			return;
+	}
+
+	if (EmitField(FieldName))
+		classObject["Name"] = WStringToString(className);
+	if (EmitField(FieldSize))
+		classObject["Size"] = length;
+
+	// Base classes
+	if (EmitField(FieldBaseClasses)) {
+		json baseClassesArray = json::array();
+		CComPtr<IDiaEnumSymbols> pBaseClasses;
+		hr = pSymbol->findChildren(SymTagBaseClass, NULL, nsNone, &pBaseClasses);
+		if (SUCCEEDED(hr)) {
+			ForEachSymbol(pBaseClasses, [&](IDiaSymbol* pBaseClass) {
+				json baseClassObject = json::object();
+				if (EmitField(FieldName)) {
+					std::wstring baseClassName = GetQualifiedName(pBaseClass);
+					baseClassObject["Name"] = WStringToString(baseClassName);
+				}
+
+				// Is virtual base class
+				if (EmitField(FieldIsVirtual)) {
+					BOOL isVirtual = FALSE;
+					pBaseClass->get_virtualBaseClass(&isVirtual);
+					baseClassObject["IsVirtual"] = isVirtual ? true : false;
+				}
+
+				// Offset
+				if (EmitField(FieldOffset)) {
+					LONG offset = 0;
+					pBaseClass->get_offset(&offset);
+					baseClassObject["Offset"] = offset;
+				}
+
+				baseClassesArray.push_back(std::move(baseClassObject));
+			});
+		}
+		classObject["BaseClasses"] = std::move(baseClassesArray);
+	}
+
+	// Methods
+	if (EmitField(FieldMethods)) {
+		json methodsArray = json::array();
+		CComPtr<IDiaEnumSymbols> pFunctions;
+		hr = pSymbol->findChildren(SymTagFunction, NULL, nsNone, &pFunctions);
+		if (SUCCEEDED(hr)) {
+			// The vtable layout walks the whole class hierarchy, so only build it if slots are wanted
+			bool emitSlots = EmitField(FieldVirtualMethodIndex | FieldVirtualTableOffset);
+			const VTableLayout* vtable = emitSlots ? &GetVTableLayout(pSymbol) : nullptr;
+			ForEachSymbol(pFunctions, [&](IDiaSymbol* pFunction) {
+				json methodObject = json::object();
+				if (EmitField(FieldName)) {
+					ScratchWString methodName = GetScratchName(pFunction);
+					methodObject["Name"] = WStringToString(methodName);
+				}
+
+				// Is virtual
+				BOOL isVirtual = FALSE;
+				if (EmitField(FieldIsVirtual) || emitSlots)
+					pFunction->get_virtual(&isVirtual);
+				if (EmitField(FieldIsVirtual))
+					methodObject["IsVirtual"] = isVirtual ? true : false;
+
+				// Is pure virtual
+				if (EmitField(FieldIsPureVirtual)) {
+					BOOL isPureVirtual = FALSE;
+					pFunction->get_pure(&isPureVirtual);
+					methodObject["IsPureVirtual"] = isPureVirtual ? true : false;
+				}
+
+				// Is static
+				if (EmitField(FieldIsStatic)) {
+					BOOL isStatic = FALSE;
+					pFunction->get_isStatic(&isStatic);
+					methodObject["IsStatic"] = isStatic ? true : false;
+				}
+
+				// Is const
+				if (EmitField(FieldIsConst)) {
+					BOOL isConst = FALSE;
+					pFunction->get_constType(&isConst);
+					methodObject["IsConst"] = isConst ? true : false;
+				}
+
+				// Virtual method index, resolved through the class hierarchy
+				if (isVirtual && emitSlots) {
+					DWORD methodId = 0;
+					pFunction->get_symIndexId(&methodId);
+					auto slot = vtable->slotsByMethodId.find(methodId);
+					if (slot != vtable->slotsByMethodId.end()) {
+						if (EmitField(FieldVirtualMethodIndex))
+							methodObject["VirtualMethodIndex"] = slot->second.offset / sessionContext->pointerSize;
+						if (EmitField(FieldVirtualTableOffset)) {
+							// The slot is only meaningful together with the table it is in
+							const VTableLayout::Table& table = vtable->tables[slot->second.table];
+							methodObject["VirtualTableOffset"] = slot->second.offset;
+							methodObject["VirtualTablePointerOffset"] = table.vfptrOffset;
+							if (table.virtualBase.id != 0)
+								methodObject["VirtualTableBase"] = std::string(table.virtualBase.utf8);
+						}
+					}
+				}
+
+				// Virtual Offset
+				if (EmitField(FieldVirtualOffset)) {
+					uintptr_t virtualAddress = 0;
+					pFunction->get_virtualAddress((ULONGLONG*)&virtualAddress);
+					methodObject["VirtualOffset"] = virtualAddress;
+				}
+
+				// Parameters
+				if (EmitField(FieldParameters))
+					methodObject["Parameters"] = BuildParametersArray(pFunction);
+
+				methodsArray.push_back(std::move(methodObject));
+			});
+		}
+		classObject["Methods"] = std::move(methodsArray);
+	}
+
+	if (dumpOptions.flattenLayout && EmitField(FieldFlattenedLayout))
+		classObject["FlattenedLayout"] = BuildFlattenedLayout(GetClassLayout(pSymbol));
+
+	arrays.classes.push_back(std::move(classObject));
+	if (previousRecords)
+		arrays.classHashes.push_back(recordHash);
+	if (claim)
+		arrays.classClaims.push_back(ClassClaim{ claim, sessionContext->symbolPosition });
+}
+
+void ProcessEnum(CComPtr<IDiaSymbol> pSymbol, SymbolArrays& arrays, const SymbolFilter& filter) {
+	json enumObject = json::object();
+
+	// Get enum definition file and line number, and skip the enum if it is filtered out
+	const RecordStore* previousRecords = sessionContext->previousRecords;
+	SourceLocation location;
+	if (filter.HasFileRules() || EmitField(FieldSourceFile | FieldLineNumber))
+		location = GetSourceLocation(pSymbol);
+	if (!PassesFileFilter(location, filter))
+		return;
+	SetSourceLocationFields(enumObject, location);
+
+	// Get enum name
+	std::wstring enumName;
+	if (filter.HasNameRules() || EmitField(FieldName))
+		enumName = GetQualifiedName(pSymbol);
+	if (!PassesNameFilter(enumName, filter))
+		return;
+
+	// Reuse the previous record if the enum is unchanged
+	ULONGLONG recordHash = 0;
+	if (previousRecords) {
+		recordHash = HashEnumRecord(pSymbol, enumName, location);
+		if (previousRecords->Find(recordHash, enumObject)) {
+			arrays.enums.push_back(std::move(enumObject));
+			arrays.enumHashes.push_back(recordHash);
+			return;
+		}
+	}
+
+	if (EmitField(FieldName))
+		enumObject["Name"] = WStringToString(enumName);
+
+	// Underlying type
+	if (EmitField(FieldUnderlyingType)) {
+		CComPtr<IDiaSymbol> pType;
+		pSymbol->get_type(&pType);
+		SetTypeField(enumObject, "UnderlyingType", pType);
+	}
+
+	// Enum values
+	if (EmitField(FieldValues)) {
+		json valuesArray = json::array();
+		CComPtr<IDiaEnumSymbols> pEnumValues;
+		HRESULT hr = pSymbol->findChildren(SymTagData, NULL, nsNone, &pEnumValues);
+		if (SUCCEEDED(hr)) {
+			ForEachSymbol(pEnumValues, [&](IDiaSymbol* pEnumValue) {
+				json valueObject = json::object();
+				if (EmitField(FieldName)) {
+					ScratchWString valueName = GetScratchName(pEnumValue);
+					valueObject["Name"] = WStringToString(valueName);
+				}
+
+				// Value
+				if (EmitField(FieldValue)) {
+					VARIANT value;
+					VariantInit(&value);
+					pEnumValue->get_value(&value);
+					if (value.vt == VT_INT) {
+						valueObject["Value"] = value.intVal;
+					}
+					else if (value.vt == VT_UI4) {
+						valueObject["Value"] = value.uintVal;
+					}
+					else if (value.vt == VT_I8) {
+						valueObject["Value"] = value.llVal;
+					}
+					else if (value.vt == VT_UI8) {
+						valueObject["Value"] = value.ullVal;
+					}
+					else {
+						valueObject["Value"] = nullptr;
+					}
+					VariantClear(&value);
+				}
+
+				valuesArray.push_back(std::move(valueObject));
+			});
+		}
+		enumObject["Values"] = std::move(valuesArray);
+	}
+
+	arrays.enums.push_back(std::move(enumObject));
+	if (previousRecords)
+		arrays.enumHashes.push_back(recordHash);
+}
+
+void ProcessTypedef(CComPtr<IDiaSymbol> pSymbol, json& typedefsArray, const SymbolFilter& filter) {
+	json typedefObject = json::object();
+
+	// Get typedef name
+	std::wstring typedefName;
+	if (filter.HasNameRules() || EmitField(FieldName))
+		typedefName = GetQualifiedName(pSymbol);
+	if (!PassesNameFilter(typedefName, filter))
+		return;
+	if (EmitField(FieldName))
+		typedefObject["Name"] = WStringToString(typedefName);
+
+	// Underlying type
+	if (EmitField(FieldUnderlyingType)) {
+		CComPtr<IDiaSymbol> pType;
+		pSymbol->get_type(&pType);
+		SetTypeField(typedefObject, "UnderlyingType", pType);
+	}
+
+	typedefsArray.push_back(std::move(typedefObject));
+}
+
+void ProcessFunction(CComPtr<IDiaSymbol> pSymbol, SymbolArrays& arrays, const SymbolFilter& filter) {
+	json functionObject = json::object();
+
+	// Functions of compilands that have no file under the prefix are skipped without any lookup
+	if (IsInExcludedCompiland(pSymbol, filter))
+		return;
+
+	// Get function definition file and line number, and skip the function if it is filtered out
+	const RecordStore* previousRecords = sessionContext->previousRecords;
+	SourceLocation location;
+	if (filter.HasFileRules() || EmitField(FieldSourceFile | FieldLineNumber))
+		location = GetSourceLocation(pSymbol);
+	if (!PassesFileFilter(location, filter))
+		return;
+	SetSourceLocationFields(functionObject, location);
+
+	// Get function name
+	std::wstring functionName;
+	if (filter.HasNameRules() || EmitField(FieldName))
+		functionName = GetQualifiedName(pSymbol);
+	if (!PassesNameFilter(functionName, filter))
+		return;
+
+	// Address and code length for the address index of --database
+	if (dumpOptions.writeDatabase) {
+		AddressRange range;
+		pSymbol->get_virtualAddress(&range.virtualOffset);
+		pSymbol->get_length(&range.size);
+		arrays.functionRanges.push_back(range);
+	}
+
+	// Reuse the previous record if the function is unchanged
+	ULONGLONG recordHash = 0;
+	if (previousRecords) {
+		recordHash = HashFunctionRecord(pSymbol, functionName, location);
+		if (previousRecords->Find(recordHash, functionObject)) {
+			arrays.functions.push_back(std::move(functionObject));
+			arrays.functionHashes.push_back(recordHash);
+			return;
+		}
+	}
+
+	if (EmitField(FieldName))
+		functionObject["Name"] = WStringToString(functionName);
+
+	// Is static
+	if (EmitField(FieldIsStatic)) {
+		BOOL isStatic = FALSE;
+		pSymbol->get_isStatic(&isStatic);
+		functionObject["IsStatic"] = isStatic ? true : false;
+	}
+
+	// Is const
+	if (EmitField(FieldIsConst)) {
+		BOOL isConst = FALSE;
+		pSymbol->get_constType(&isConst);
+		functionObject["IsConst"] = isConst ? true : false;
+	}
+
+	// Virtual Offset
+	if (EmitField(FieldVirtualOffset)) {
+		uintptr_t virtualAddress = 0;
+		pSymbol->get_virtualAddress((ULONGLONG*)&virtualAddress);
+		functionObject["VirtualOffset"] = virtualAddress;
+	}
+
+	// Parameters
+	if (EmitField(FieldParameters))
+		functionObject["Parameters"] = BuildParametersArray(pSymbol);
+
+	arrays.functions.push_back(std::move(functionObject));
+	if (previousRecords)
+		arrays.functionHashes.push_back(recordHash);
+}
+
+void ProcessData(CComPtr<IDiaSymbol> pSymbol, SymbolArrays& arrays, const SymbolFilter& filter) {
+	json dataObject = json::object();
+
+	if (IsInExcludedCompiland(pSymbol, filter))
+		return;
+
+	// Get variable definition file and line number, and skip the variable if it is filtered out
+	SourceLocation location;
+	if (filter.HasFileRules() || EmitField(FieldSourceFile | FieldLineNumber))
+		location = GetSourceLocation(pSymbol);
+	if (!PassesFileFilter(location, filter))
+		return;
+	SetSourceLocationFields(dataObject, location);
+
+	// Get variable name
+	std::wstring varName;
+	if (filter.HasNameRules() || EmitField(FieldName))
+		varName = GetQualifiedName(pSymbol);
+	if (!PassesNameFilter(varName, filter))
+		return;
+	if (EmitField(FieldName))
+		dataObject["Name"] = WStringToString(varName);
+
+	// Type, and the address and type size for the address index of --database
+	if (EmitField(FieldType) || dumpOptions.writeDatabase) {
+		CComPtr<IDiaSymbol> pType;
+		pSymbol->get_type(&pType);
+		if (EmitField(FieldType))
+			SetTypeField(dataObject, "Type", pType);
+		if (dumpOptions.writeDatabase) {
+			AddressRange range;
+			pSymbol->get_virtualAddress(&range.virtualOffset);
+			if (pType)
+				pType->get_length(&range.size);
+			arrays.globalRanges.push_back(range);
+		}
+	}
+
+	// Is static
+	if (EmitField(FieldIsStatic)) {
+		DWORD locationType = 0;
+		pSymbol->get_locationType(&locationType);
+		dataObject["IsStatic"] = (locationType == LocIsStatic) ? true : false;
+	}
+
+	// Is const
+	if (EmitField(FieldIsConst)) {
+		BOOL isConst = FALSE;
+		pSymbol->get_constType(&isConst);
+		dataObject["IsConst"] = isConst ? true : false;
+	}
+
+	// Virtual Offset
+	if (EmitField(FieldVirtualOffset)) {
+		uintptr_t virtualAddress = 0;
+		pSymbol->get_virtualAddress((ULONGLONG*)&virtualAddress);
+		dataObject["VirtualOffset"] = virtualAddress;
+	}
+
+	arrays.globals.push_back(std::move(dataObject));
+}
+
+// Record hashes for --incremental. DIA doesn't expose the raw type records, so a record hash is
+// built from the properties its record is extracted from, read with the cheapest accessors;
+// types are covered by their type IDs, which are derived from the type names and shapes. Only
+// what the --fields projection emits is hashed, the way extraction reads it, so that a relink
+// which only moves code leaves the hashes of records without VirtualOffset unchanged. The record
+// file is tied to the projection by the output options hash.
+ULONGLONG HashSourceLocation(const SourceLocation& location, ULONGLONG hash) {
+	if (EmitField(FieldSourceFile))
+		hash = HashBytes(location.file.wide.data(), location.file.wide.size() * sizeof(wchar_t), hash);
+	if (EmitField(FieldLineNumber))
+		hash = HashBytes(&location.lineNumber, sizeof(location.lineNumber), hash);
+	return hash;
+}
+
+// The parameter list as BuildParametersArray emits it: one entry per parameter, with its type
+ULONGLONG HashParameters(IDiaSymbol* pFunction, ULONGLONG hash) {
+	CComPtr<IDiaEnumSymbols> pParams;
+	if (FAILED(pFunction->findChildren(SymTagFunctionArgType, NULL, nsNone, &pParams)))
+		return hash;
+
+	ForEachSymbol(pParams, [&](IDiaSymbol* pParam) {
+		ULONGLONG typeId = 0;
+		if (EmitField(FieldType)) {
+			CComPtr<IDiaSymbol> pType;
+			pParam->get_type(&pType);
+			typeId = GetTypeId(pType);
+		}
+		hash = HashBytes(&typeId, sizeof(typeId), hash);
+	});
+	return hash;
+}
+
+// Whether class records depend on the members of their base classes, as vtable slots and
+// flattened layouts do
+bool RecordsDependOnBases() {
+	return (EmitField(FieldMethods) && EmitField(FieldVirtualMethodIndex | FieldVirtualTableOffset)) ||
+		(dumpOptions.flattenLayout && EmitField(FieldFlattenedLayout));
+}
+
+// Hashes of a class's members in one walk, memoized per session since every derived class
+// hashes its bases again. `record` covers the base classes, fields and methods as ProcessUDT
+// emits them. `layout` covers what vtable slots and flattened layouts are built from, base
+// classes included and addresses left out, and is only taken when the projection emits either;
+// `record` then includes it. `fields` is the class key's hash when deduplicating.
+ClassMemberHashes HashClassMembers(IDiaSymbol* pUDT) {
+	DWORD symIndexId = 0;
+	pUDT->get_symIndexId(&symIndexId);
+	auto it = sessionContext->classMemberHashes.find(symIndexId);
+	if (it != sessionContext->classMemberHashes.end())
+		return it->second;
+
+	bool hashLayout = RecordsDependOnBases();
+	bool hashKey = sessionContext->classDedup && EmitField(FieldFields);
+	ULONGLONG recordHash = HashBytes(nullptr, 0);
+	ULONGLONG layoutHash = HashBytes(nullptr, 0);
+	ULONGLONG fieldHash = HashBytes(nullptr, 0);
+	CComPtr<IDiaEnumSymbols> pChildren;
+	if (SUCCEEDED(pUDT->findChildren(SymTagNull, NULL, nsNone, &pChildren))) {
+		ForEachSymbol(pChildren, [&](IDiaSymbol* pChild) {
+			DWORD symTag = 0;
+			pChild->get_symTag(&symTag);
+			bool emitted = (symTag == SymTagBaseClass && EmitField(FieldBaseClasses)) ||
+				(symTag == SymTagData && EmitField(FieldFields)) || (symTag == SymTagFunction && EmitField(FieldMethods));
+			bool keyed = hashKey && symTag == SymTagData;
+			if (!emitted && !keyed && !(hashLayout && (symTag == SymTagBaseClass || symTag == SymTagData ||
+				symTag == SymTagFunction || symTag == SymTagVTable)))
+				return;
+
+			// Reads a value if the record emits it or the layout needs it, and hashes it into each
+			auto wanted = [&](DWORD fieldMask) { return (emitted && EmitField(fieldMask)) || hashLayout; };
+			auto add = [&](DWORD fieldMask, const void* data, size_t size) {
+				if (emitted && EmitField(fieldMask))
+					recordHash = HashBytes(data, size, recordHash);
+				if (hashLayout)
+					layoutHash = HashBytes(data, size, layoutHash);
+			};
+			add(FieldAll, &symTag, sizeof(symTag));
+
+			ScratchWString name = symTag != SymTagVTable && (wanted(FieldName) || keyed) ? GetScratchName(pChild) : ScratchWString();
+			add(FieldName, name.data(), name.size() * sizeof(wchar_t));
+
+			LONG offset = 0;
+			if (symTag != SymTagFunction && (wanted(FieldOffset) || keyed)) {
+				pChild->get_offset(&offset);
+				add(FieldOffset, &offset, sizeof(offset));
+			}
+
+			if (symTag == SymTagBaseClass) {
+				BOOL isVirtual = FALSE;
+				if (wanted(FieldIsVirtual)) {
+					pChild->get_virtualBaseClass(&isVirtual);
+					add(FieldIsVirtual, &isVirtual, sizeof(isVirtual));
+				}
+
+				CComPtr<IDiaSymbol> pBaseType;
+				if (hashLayout && pChild->get_type(&pBaseType) == S_OK && pBaseType) {
+					ULONGLONG baseHash[] = { GetTypeId(pBaseType), HashClassMembers(pBaseType).layout };
+					layoutHash = HashBytes(baseHash, sizeof(baseHash), layoutHash);
+				}
+			}
+			else if (symTag == SymTagData) {
+				ULONGLONG typeId = 0;
+				if (wanted(FieldType) || keyed) {
+					CComPtr<IDiaSymbol> pType;
+					pChild->get_type(&pType);
+					typeId = GetTypeId(pType);
+					add(FieldType, &typeId, sizeof(typeId));
+				}
+
+				DWORD locationType = 0;
+				if (wanted(FieldIsStatic | FieldBitPosition | FieldBitWidth)) {
+					pChild->get_locationType(&locationType);
+					add(FieldIsStatic | FieldBitPosition | FieldBitWidth, &locationType, sizeof(locationType));
+				}
+				if (wanted(FieldIsConst)) {
+					BOOL isConst = FALSE;
+					pChild->get_constType(&isConst);
+					add(FieldIsConst, &isConst, sizeof(isConst));
+				}
+				if (locationType == LocIsBitField) {
+					if (wanted(FieldBitPosition)) {
+						DWORD bitPosition = 0;
+						pChild->get_bitPosition(&bitPosition);
+						add(FieldBitPosition, &bitPosition, sizeof(bitPosition));
+					}
+					if (wanted(FieldBitWidth)) {
+						ULONGLONG bitWidth = 0;
+						pChild->get_length(&bitWidth);
+						add(FieldBitWidth, &bitWidth, sizeof(bitWidth));
+					}
+				}
+
+				// Addresses never shape a layout, so they only go into the record
+				if (emitted && EmitField(FieldVirtualOffset)) {
+					ULONGLONG virtualAddress = 0;
+					pChild->get_virtualAddress(&virtualAddress);
+					recordHash = HashBytes(&virtualAddress, sizeof(virtualAddress), recordHash);
+				}
+
+				// The class key hashes the same name, type ID and offset as ProcessUDT's field walk
+				if (keyed) {
+					fieldHash = HashBytes(name.data(), name.size() * sizeof(wchar_t), fieldHash);
+					fieldHash = HashBytes(&typeId, sizeof(typeId), fieldHash);
+					fieldHash = HashBytes(&offset, sizeof(offset), fieldHash);
+				}
+			}
+			else if (symTag == SymTagFunction) {
+				// Whether a method is virtual decides whether it gets a slot
+				if (wanted(FieldIsVirtual | FieldVirtualMethodIndex | FieldVirtualTableOffset)) {
+					BOOL isVirtual = FALSE;
+					pChild->get_virtual(&isVirtual);
+					add(FieldIsVirtual | FieldVirtualMethodIndex | FieldVirtualTableOffset, &isVirtual, sizeof(isVirtual));
+				}
+				if (wanted(FieldIsPureVirtual)) {
+					BOOL isPureVirtual = FALSE;
+					pChild->get_pure(&isPureVirtual);
+					add(FieldIsPureVirtual, &isPureVirtual, sizeof(isPureVirtual));
+				}
+				if (wanted(FieldIsStatic)) {
+					BOOL isStatic = FALSE;
+					pChild->get_isStatic(&isStatic);
+					add(FieldIsStatic, &isStatic, sizeof(isStatic));
+				}
+				if (wanted(FieldIsConst)) {
+					BOOL isConst = FALSE;
+					pChild->get_constType(&isConst);
+					add(FieldIsConst, &isConst, sizeof(isConst));
+				}
+				if (emitted && EmitField(FieldVirtualOffset)) {
+					ULONGLONG virtualAddress = 0;
+					pChild->get_virtualAddress(&virtualAddress);
+					recordHash = HashBytes(&virtualAddress, sizeof(virtualAddress), recordHash);
+				}
+
+				// Parameter types are part of the signatures vtable slots are matched by
+				if (emitted && EmitField(FieldParameters))
+					recordHash = HashParameters(pChild, recordHash);
+				if (hashLayout) {
+					CComPtr<IDiaEnumSymbols> pParams;
+					if (SUCCEEDED(pChild->findChildren(SymTagFunctionArgType, NULL, nsNone, &pParams))) {
+						ForEachSymbol(pParams, [&](IDiaSymbol* pParam) {
+							CComPtr<IDiaSymbol> pType;
+							pParam->get_type(&pType);
+							ULONGLONG typeId = GetTypeId(pType);
+							layoutHash = HashBytes(&typeId, sizeof(typeId), layoutHash);
+						});
+					}
+				}
+			}
+		});
+	}
+
+	if (hashLayout)
+		recordHash = HashBytes(&layoutHash, sizeof(layoutHash), recordHash);
+	ClassMemberHashes hashes{ recordHash, hashLayout ? layoutHash : 0, hashKey ? fieldHash : 0 };
+	sessionContext->classMemberHashes.emplace(symIndexId, hashes);
+	return hashes;
+}
+
+// Also returns the hash of the data members for the class key in `fieldHash`
+ULONGLONG HashClassRecord(IDiaSymbol* pUDT, const std::wstring& name, ULONGLONG length, const SourceLocation& location, ULONGLONG& fieldHash) {
+	ClassMemberHashes hashes = HashClassMembers(pUDT);
+	fieldHash = hashes.fields;
+	// Flattened layouts are checked against the class size even when it isn't emitted
+	bool hashSize = EmitField(FieldSize) || RecordsDependOnBases();
+	ULONGLONG values[] = { KindClasses, hashSize ? length : 0, sessionContext->pointerSize, hashes.record };
+	ULONGLONG hash = HashBytes(values, sizeof(values));
+	if (EmitField(FieldName))
+		hash = HashBytes(name.c_str(), name.size() * sizeof(wchar_t), hash);
+	return HashSourceLocation(location, hash);
+}
+
+ULONGLONG HashEnumRecord(IDiaSymbol* pEnum, const std::wstring& name, const SourceLocation& location) {
+	ULONGLONG values[] = { KindEnums, 0 };
+	if (EmitField(FieldUnderlyingType)) {
+		CComPtr<IDiaSymbol> pType;
+		pEnum->get_type(&pType);
+		values[1] = GetTypeId(pType);
+	}
+	ULONGLONG hash = HashBytes(values, sizeof(values));
+	if (EmitField(FieldName))
+		hash = HashBytes(name.c_str(), name.size() * sizeof(wchar_t), hash);
+	hash = HashSourceLocation(location, hash);
+
+	CComPtr<IDiaEnumSymbols> pEnumValues;
+	if (!EmitField(FieldValues) || FAILED(pEnum->findChildren(SymTagData, NULL, nsNone, &pEnumValues)))
+		return hash;
+
+	ForEachSymbol(pEnumValues, [&](IDiaSymbol* pEnumValue) {
+		// One entry per value, whatever the value objects hold
+		DWORD symTag = SymTagData;
+		hash = HashBytes(&symTag, sizeof(symTag), hash);
+		if (EmitField(FieldName)) {
+			ScratchWString valueName = GetScratchName(pEnumValue);
+			hash = HashBytes(valueName.data(), valueName.size() * sizeof(wchar_t), hash);
+		}
+		if (!EmitField(FieldValue))
+			return;
+
+		// Only the types the record spells out as numbers are told apart
+		VARIANT value;
+		VariantInit(&value);
+		pEnumValue->get_value(&value);
+		ULONGLONG bits[] = { value.vt, 0 };
+		if (value.vt == VT_INT)
+			bits[1] = static_cast<ULONGLONG>(value.intVal);
+		else if (value.vt == VT_UI4)
+			bits[1] = value.uintVal;
+		else if (value.vt == VT_I8)
+			bits[1] = static_cast<ULONGLONG>(value.llVal);
+		else if (value.vt == VT_UI8)
+			bits[1] = value.ullVal;
+		VariantClear(&value);
+		hash = HashBytes(bits, sizeof(bits), hash);
+	});
+	return hash;
+}
+
+ULONGLONG HashFunctionRecord(IDiaSymbol* pFunction, const std::wstring& name, const SourceLocation& location) {
+	BOOL isStatic = FALSE, isConst = FALSE;
+	ULONGLONG values[] = { KindFunctions, 0, 0 };
+	if (EmitField(FieldIsStatic))
+		pFunction->get_isStatic(&isStatic);
+	if (EmitField(FieldIsConst))
+		pFunction->get_constType(&isConst);
+	if (EmitField(FieldVirtualOffset))
+		pFunction->get_virtualAddress(&values[1]);
+	values[2] = (static_cast<ULONGLONG>(isStatic) << 1) | (isConst ? 1 : 0);
+	ULONGLONG hash = HashBytes(values, sizeof(values));
+	if (EmitField(FieldName))
+		hash = HashBytes(name.c_str(), name.size() * sizeof(wchar_t), hash);
+	hash = HashSourceLocation(location, hash);
+	return EmitField(FieldParameters) ? HashParameters(pFunction, hash) : hash;
+}
+
+// Parameter list of a function or method
+json BuildParametersArray(IDiaSymbol* pFunction) {
+	json paramsArray = json::array();
+	CComPtr<IDiaEnumSymbols> pParams;
+	HRESULT hr = pFunction->findChildren(SymTagFunctionArgType, NULL, nsNone, &pParams);
+	if (SUCCEEDED(hr)) {
+		ForEachSymbol(pParams, [&](IDiaSymbol* pParam) {
+			json paramObject = json::object();
+
+			// Parameter type
+			if (EmitField(FieldType)) {
+				CComPtr<IDiaSymbol> pType;
+				pParam->get_type(&pType);
+				SetTypeField(paramObject, "Type", pType);
+			}
+
+			paramsArray.push_back(std::move(paramObject));
+		});
+	}
+	return paramsArray;
+}
+
+void SetSourceLocationFields(json& object, const SourceLocation& location) {
+	if (location.file.id != 0 && EmitField(FieldSourceFile))
+		object["SourceFile"] = std::string(location.file.utf8);
+	if (location.lineNumber != 0 && EmitField(FieldLineNumber))
+		object["LineNumber"] = location.lineNumber;
+}
+
+// Helper functions
+
+std::wstring GetSymbolName(CComPtr<IDiaSymbol> pSymbol) {
+	BSTR bstrName = NULL;
+	pSymbol->get_name(&bstrName);
+	std::wstring name = bstrName ? bstrName : L"";
+	SysFreeString(bstrName);
+	return name;
+}
+
+// Name of a symbol in scratch memory, for names that are only converted for output
+ScratchWString GetScratchName(IDiaSymbol* pSymbol) {
+	BSTR bstrName = NULL;
+	pSymbol->get_name(&bstrName);
+	ScratchWString name(bstrName ? bstrName : L"", scratchArena.GetResource());
+	SysFreeString(bstrName);
+	return name;
+}
+
+std::wstring GetUndecoratedName(CComPtr<IDiaSymbol> pSymbol) {
+	BSTR bstrName = NULL;
+	pSymbol->get_undecoratedName(&bstrName);
+	std::wstring name = bstrName ? bstrName : L"";
+	SysFreeString(bstrName);
+	return name;
+}
+
+// Name of a type or global symbol, with template aliases applied when enabled
+std::wstring GetQualifiedName(CComPtr<IDiaSymbol> pSymbol) {
+	return CanonicalizeTemplateName(GetSymbolName(pSymbol));
+}
+
+std::wstring CanonicalizeTemplateName(const std::wstring& name) {
+	if (!dumpOptions.templateAliases || name.find(L'<') == std::wstring::npos)
+		return name;
+
+	TemplateNameInterner& templateNames = sessionContext->namePools->templateNames;
+	return templateNames.RenderCanonical(templateNames.Intern(name));
+}
+
+// Resolves file and line with at most one line-table lookup
+SourceLocation GetSourceLocation(IDiaSymbol* pSymbol) {
+	SourceLocation location;
+
+	// Try to get the source file name directly
+	BSTR bstrFileName = NULL;
+	HRESULT hr = pSymbol->get_sourceFileName(&bstrFileName);
+	if (SUCCEEDED(hr) && bstrFileName) {
+		location.file = sessionContext->namePools->strings.Intern(bstrFileName);
+		SysFreeString(bstrFileName);
+	}
+
+	CComPtr<IDiaLineNumber> pLineNumber;
+	hr = pSymbol->getSrcLineOnTypeDefn(&pLineNumber);
+	if (FAILED(hr) || !pLineNumber)
+		return location;
+
+	DWORD lineNumber = 0;
+	if (SUCCEEDED(pLineNumber->get_lineNumber(&lineNumber)))
+		location.lineNumber = lineNumber;
+
+	// If the above fails, take the file from the line number
+	if (location.file.id != 0)
+		return location;
+
+	CComPtr<IDiaSourceFile> pSourceFile;
+	hr = pLineNumber->get_sourceFile(&pSourceFile);
+	if (SUCCEEDED(hr) && pSourceFile)
+		location.file = GetSourceFileName(pSourceFile);
+	return location;
+}
+
+// Names of source files are cached per session by the file's unique ID
+InternedString GetSourceFileName(IDiaSourceFile* pSourceFile) {
+	DWORD uniqueId = 0;
+	bool cacheable = SUCCEEDED(pSourceFile->get_uniqueId(&uniqueId));
+	if (cacheable) {
+		auto it = sessionContext->sourceFileCache.find(uniqueId);
+		if (it != sessionContext->sourceFileCache.end())
+			return it->second;
+	}
+
+	InternedString fileName;
+	BSTR bstrFileName = NULL;
+	HRESULT hr = pSourceFile->get_fileName(&bstrFileName);
+	if (SUCCEEDED(hr) && bstrFileName) {
+		fileName = sessionContext->namePools->strings.Intern(bstrFileName);
+		SysFreeString(bstrFileName);
+	}
+	if (cacheable)
+		sessionContext->sourceFileCache.emplace(uniqueId, fileName);
+	return fileName;
+}
+
+// Symbols whose source file is unknown are never filtered out. Results are kept per session by
+// interned file name, so each file is matched against the rules once.
+bool PassesFileFilter(const SourceLocation& location, const SymbolFilter& filter) {
+	if (!filter.HasFileRules() || location.file.id == 0)
+		return true;
+
+	auto it = sessionContext->fileFilterResults.find(location.file.id);
+	if (it != sessionContext->fileFilterResults.end())
+		return it->second;
+
+	bool passes = filter.MatchesFile(location.file.wide);
+	sessionContext->fileFilterResults.emplace(location.file.id, passes);
+	return passes;
+}
+
+bool PassesNameFilter(const std::wstring& name, const SymbolFilter& filter) {
+	return !filter.HasNameRules() || sessionContext->nameDfa.Passes(filter.GetNameRules(), name);
+}
+
+// A function or variable whose lexical parent is a compiland can only be defined in one of that
+// compiland's source files, so when none of them passes the file filter the symbol can be
+// skipped before anything else about it is fetched
+bool IsInExcludedCompiland(IDiaSymbol* pSymbol, const SymbolFilter& filter) {
+	if (!filter.HasFileRules())
+		return false;
+
+	SessionContext& context = *sessionContext;
+	if (!context.compilandsScanned) {
+		FindExcludedCompilands(context, filter);
+		context.compilandsScanned = true;
+	}
+	if (context.excludedCompilands.empty())
+		return false;
+
+	DWORD parentId = 0;
+	if (pSymbol->get_lexicalParentId(&parentId) != S_OK)
+		return false;
+	return context.excludedCompilands.count(parentId) != 0;
+}
+
+// Compilands whose source files can't be listed are kept
+void FindExcludedCompilands(SessionContext& context, const SymbolFilter& filter) {
+	CComPtr<IDiaEnumSymbols> pCompilands;
+	if (FAILED(context.pGlobal->findChildren(SymTagCompiland, NULL, nsNone, &pCompilands)))
+		return;
+
+	ForEachSymbol(pCompilands, [&](IDiaSymbol* pCompiland) {
+		DWORD compilandId = 0;
+		CComPtr<IDiaEnumSourceFiles> pSourceFiles;
+		if (pCompiland->get_symIndexId(&compilandId) != S_OK
+			|| context.pSession->findFile(pCompiland, NULL, nsNone, &pSourceFiles) != S_OK)
+			return;
+
+		bool hasFiles = false;
+		CComPtr<IDiaSourceFile> pSourceFile;
+		ULONG fetched = 0;
+		while (SUCCEEDED(pSourceFiles->Next(1, &pSourceFile, &fetched)) && fetched == 1) {
+			SourceLocation location;
+			location.file = GetSourceFileName(pSourceFile);
+			pSourceFile.Release();
+			if (location.file.id == 0)
+				continue;
+
+			hasFiles = true;
+			if (PassesFileFilter(location, filter))
+				return;
+		}
+
+		if (hasFiles)
+			context.excludedCompilands.insert(compilandId);
+	});
+}
+
+std::wstring GetBasicTypeName(DWORD baseType, DWORD length) {
+	switch (baseType) {
+	case btVoid:
+		return L"void";
+	case btChar:
+		return L"char";
+	case btWChar:
+		return L"wchar_t";
+	case btInt:
+		if (length == 1) return L"int8_t";
+		else if (length == 2) return L"int16_t";
+		else if (length == 4) return L"int32_t";
+		else if (length == 8) return L"int64_t";
+		else return L"int";
+	case btUInt:
+		if (length == 1) return L"uint8_t";
+		else if (length == 2) return L"uint16_t";
+		else if (length == 4) return L"uint32_t";
+		else if (length == 8) return L"uint64_t";
+		else return L"unsigned int";
+	case btFloat:
+		if (length == 4) return L"float";
+		else if (length == 8) return L"double";
+		else if (length == 10) return L"long double";
+		else return L"float";
+	case btBool:
+		return L"bool";
+	case btLong:
+		return L"long";
+	case btULong:
+		return L"unsigned long";
+	default:
+		return L"unknown";
+	}
+}
+
+// Hash of the names and offsets of the data members of a class, or of the values of an enum. Member
+// types are left out so that hashing never recurses into other types.
+ULONGLONG HashMemberNames(IDiaSymbol* pType) {
+	ULONGLONG hash = HashBytes(nullptr, 0);
+	CComPtr<IDiaEnumSymbols> pDataMembers;
+	if (FAILED(pType->findChildren(SymTagData, NULL, nsNone, &pDataMembers)))
+		return hash;
+
+	ForEachSymbol(pDataMembers, [&](IDiaSymbol* pDataMember) {
+		ScratchWString memberName = GetScratchName(pDataMember);
+		hash = HashBytes(memberName.data(), memberName.size() * sizeof(wchar_t), hash);
+
+		LONG offset = 0;
+		pDataMember->get_offset(&offset);
+		hash = HashBytes(&offset, sizeof(offset), hash);
+	});
+	return hash;
+}
+
+const ResolvedType& ResolveType(CComPtr<IDiaSymbol> pType) {
+	DWORD symIndexId = 0;
+	pType->get_symIndexId(&symIndexId);
+
+	// Check if the type is already in the cache
+	auto& typeCache = sessionContext->typeCache;
+	auto it = typeCache.find(symIndexId);
+	if (it != typeCache.end()) {
+		return it->second;
+	}
+
+	DWORD symTag = 0;
+	pType->get_symTag(&symTag);
+	ResolvedType resolved;
+	TypeDescriptor& descriptor = resolved.descriptor;
+	ULONGLONG memberHash = 0;
+
+	ULONGLONG length = 0;
+	pType->get_length(&length);
+
+	BOOL isConst = FALSE;
+	BOOL isVolatile = FALSE;
+	pType->get_constType(&isConst);
+	pType->get_volatileType(&isVolatile);
+	DWORD cvFlags = (isConst ? TypeCvConst : 0) | (isVolatile ? TypeCvVolatile : 0);
+
+	// Pointers and arrays are resolved through their element type
+	static const ResolvedType unresolvedType;
+	CComPtr<IDiaSymbol> pBaseType;
+	if (symTag == SymTagPointerType || symTag == SymTagArrayType)
+		pType->get_type(&pBaseType);
+
+	if (symTag == SymTagPointerType) {
+		const ResolvedType& base = pBaseType ? ResolveType(pBaseType) : unresolvedType;
+		resolved.name = sessionContext->namePools->strings.Intern(std::wstring(base.name.wide) + L"*");
+
+		if (base.descriptor.arrayDimensions.empty()) {
+			descriptor = base.descriptor;
+			descriptor.pointerDepth++;
+			descriptor.pointerCvFlags.insert(descriptor.pointerCvFlags.begin(), cvFlags);
+		}
+		else {
+			// Pointer to an array: the array itself becomes the base type
+			descriptor.kind = SymTagArrayType;
+			descriptor.baseTypeId = base.typeId;
+			descriptor.baseCvFlags = base.descriptor.cvFlags;
+			descriptor.pointerDepth = 1;
+			descriptor.pointerCvFlags.assign(1, cvFlags);
+		}
+
+		BOOL isReference = FALSE;
+		pType->get_reference(&isReference);
+		descriptor.isReference = isReference ? true : false;
+	}
+	else if (symTag == SymTagArrayType) {
+		DWORD count = 0;
+		pType->get_count(&count);
+		const ResolvedType& base = pBaseType ? ResolveType(pBaseType) : unresolvedType;
+		resolved.name = sessionContext->namePools->strings.Intern(std::wstring(base.name.wide) + L"[" + std::to_wstring(count) + L"]");
+
+		descriptor = base.descriptor;
+		descriptor.arrayDimensions.insert(descriptor.arrayDimensions.begin(), count);
+	}
+	else {
+		if (symTag == SymTagBaseType) {
+			DWORD baseType;
+			pType->get_baseType(&baseType);
+			resolved.name = sessionContext->namePools->strings.Intern(GetBasicTypeName(baseType, (DWORD)length));
+		}
+		else {
+			// For other types, return the name
+			resolved.name = sessionContext->namePools->strings.Intern(GetQualifiedName(pType));
+		}
+
+		// Names don't identify classes and enums on their own: "<unnamed-tag>", local types and
+		// ODR violations give different types the same name, so their members go into the type ID
+		if (symTag == SymTagUDT || symTag == SymTagEnum)
+			memberHash = HashMemberNames(pType);
+
+		descriptor.kind = symTag;
+		descriptor.baseCvFlags = cvFlags;
+	}
+
+	descriptor.cvFlags = cvFlags;
+	descriptor.size = length;
+
+	// Derive the type ID from everything that is emitted for the type
+	ULONGLONG typeId = HashBytes(resolved.name.wide.data(), resolved.name.wide.size() * sizeof(wchar_t));
+	typeId = HashBytes(&descriptor.kind, sizeof(descriptor.kind), typeId);
+	typeId = HashBytes(&descriptor.baseTypeId, sizeof(descriptor.baseTypeId), typeId);
+	typeId = HashBytes(&descriptor.pointerDepth, sizeof(descriptor.pointerDepth), typeId);
+	typeId = HashBytes(&descriptor.isReference, sizeof(descriptor.isReference), typeId);
+	typeId = HashBytes(descriptor.arrayDimensions.data(), descriptor.arrayDimensions.size() * sizeof(DWORD), typeId);
+	typeId = HashBytes(&descriptor.cvFlags, sizeof(descriptor.cvFlags), typeId);
+	typeId = HashBytes(descriptor.pointerCvFlags.data(), descriptor.pointerCvFlags.size() * sizeof(DWORD), typeId);
+	typeId = HashBytes(&descriptor.baseCvFlags, sizeof(descriptor.baseCvFlags), typeId);
+	typeId = HashBytes(&descriptor.size, sizeof(descriptor.size), typeId);
+	typeId = HashBytes(&memberHash, sizeof(memberHash), typeId);
+	// Keep IDs within the 53 bits a JSON number can hold exactly
+	resolved.typeId = typeId & ((1ULL << 53) - 1);
+	if (descriptor.baseTypeId == 0)
+		descriptor.baseTypeId = resolved.typeId;
+
+	// Cache the resolved type
+	return typeCache.emplace(symIndexId, std::move(resolved)).first->second;
+}
+
+std::wstring GetTypeName(CComPtr<IDiaSymbol> pType) {
+	if (!pType)
+		return L"";
+
+	return std::wstring(ResolveType(pType).name.wide);
+}
+
+ULONGLONG GetTypeId(CComPtr<IDiaSymbol> pType) {
+	if (!pType)
+		return 0;
+	return ResolveType(pType).typeId;
+}
+
+// 64-bit FNV-1a; pass a previous result as `hash` to continue hashing
+ULONGLONG HashBytes(const void* data, size_t size, ULONGLONG hash) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// Writes the type name under `key`, plus a "<key>Id" reference into the "Types" table when enabled
+void SetTypeField(json& object, const char* key, CComPtr<IDiaSymbol> pType) {
+	object[key] = pType ? std::string(ResolveType(pType).name.utf8) : std::string();
+
+	if (dumpOptions.emitTypeDescriptors && pType)
+		object[std::string(key) + "Id"] = GetTypeId(pType);
+}
+
+// Size of a pointer (and of a vtable slot) for the image the PDB describes
+DWORD GetPointerSize(CComPtr<IDiaSymbol> pGlobal) {
+	DWORD machineType = 0;
+	if (pGlobal->get_machineType(&machineType) == S_OK) {
+		switch (machineType) {
+		case IMAGE_FILE_MACHINE_I386:
+		case IMAGE_FILE_MACHINE_ARMNT:
+			return 4;
+		case IMAGE_FILE_MACHINE_AMD64:
+		case IMAGE_FILE_MACHINE_ARM64:
+			return 8;
+		default:
+			break;
+		}
+	}
+	return sizeof(void*);
+}
+
+// Key that matches a virtual method with its overrides: name, parameter types and constness.
+// Destructors override each other regardless of their name.
+std::wstring GetMethodSignature(CComPtr<IDiaSymbol> pFunction) {
+	std::wstring signature = GetSymbolName(pFunction);
+	if (!signature.empty() && signature[0] == L'~')
+		return L"~";
+
+	signature += L'(';
+	CComPtr<IDiaEnumSymbols> pParams;
+	if (SUCCEEDED(pFunction->findChildren(SymTagFunctionArgType, NULL, nsNone, &pParams))) {
+		bool first = true;
+		ForEachSymbol(pParams, [&](IDiaSymbol* pParam) {
+			CComPtr<IDiaSymbol> pType;
+			pParam->get_type(&pType);
+			if (!first)
+				signature += L',';
+			signature += GetTypeName(pType);
+			first = false;
+		});
+	}
+	signature += L')';
+
+	BOOL isConst = FALSE;
+	pFunction->get_constType(&isConst);
+	if (isConst)
+		signature += L" const";
+	return signature;
+}
+
+// Builds (or returns the memoized) vtable layout of a class. The tables of the bases are taken over
+// first, each at its place in this class, so that overrides resolve to the table and slot their
+// base introduced; each class in a hierarchy is walked once.
+const VTableLayout& GetVTableLayout(CComPtr<IDiaSymbol> pUDT) {
+	DWORD classId = 0;
+	pUDT->get_symIndexId(&classId);
+
+	auto& vtableCache = sessionContext->vtableCache;
+	auto it = vtableCache.find(classId);
+	if (it != vtableCache.end())
+		return it->second;
+
+	VTableLayout layout;
+	auto findTable = [&layout](const InternedString& virtualBase, LONG vfptrOffset) {
+		for (size_t i = 0; i < layout.tables.size(); i++) {
+			if (layout.tables[i].virtualBase.id == virtualBase.id && layout.tables[i].vfptrOffset == vfptrOffset)
+				return i;
+		}
+		return layout.tables.size();
+	};
+
+	// Tables of base classes; a virtual base reached through several paths is shared, so it is kept once
+	CComPtr<IDiaEnumSymbols> pBaseClasses;
+	if (SUCCEEDED(pUDT->findChildren(SymTagBaseClass, NULL, nsNone, &pBaseClasses))) {
+		ForEachSymbol(pBaseClasses, [&](IDiaSymbol* pBaseClass) {
+			CComPtr<IDiaSymbol> pBaseType;
+			if (pBaseClass->get_type(&pBaseType) != S_OK || !pBaseType)
+				return;
+
+			const VTableLayout& baseLayout = GetVTableLayout(pBaseType);
+			if (baseLayout.tables.empty())
+				return;
+
+			BOOL isVirtual = FALSE;
+			pBaseClass->get_virtualBaseClass(&isVirtual);
+			LONG baseOffset = 0;
+			InternedString baseName;
+			if (isVirtual)
+				baseName = sessionContext->namePools->strings.Intern(GetQualifiedName(pBaseType));
+			else
+				pBaseClass->get_offset(&baseOffset);
+
+			for (VTableLayout::Table table : baseLayout.tables) {
+				if (table.virtualBase.id == 0) {
+					if (isVirtual)
+						table.virtualBase = baseName;
+					else
+						table.vfptrOffset += baseOffset;
+				}
+				if (findTable(table.virtualBase, table.vfptrOffset) == layout.tables.size())
+					layout.tables.push_back(std::move(table));
+			}
+		});
+	}
+
+	// New virtual methods extend the primary table. MSVC places it at offset 0: it is the table of
+	// the first base with a vfptr, or the class's own if no non-virtual base has one.
+	auto primaryTable = [&]() {
+		size_t index = findTable(InternedString(), 0);
+		if (index == layout.tables.size())
+			layout.tables.emplace_back();
+		return index;
+	};
+
+	// Own virtual methods: introducing methods carry their vtable offset, overrides look it up. An
+	// override's `this` adjustment is the offset of the vfptr of the table it was introduced in,
+	// which picks the right table when several bases declare the same signature.
+	CComPtr<IDiaEnumSymbols> pFunctions;
+	if (SUCCEEDED(pUDT->findChildren(SymTagFunction, NULL, nsNone, &pFunctions))) {
+		ForEachSymbol(pFunctions, [&](IDiaSymbol* pFunction) {
+			BOOL isVirtual = FALSE;
+			pFunction->get_virtual(&isVirtual);
+			if (isVirtual) {
+				BOOL isIntro = FALSE;
+				pFunction->get_intro(&isIntro);
+				DWORD vtableOffset = 0;
+				pFunction->get_virtualBaseOffset(&vtableOffset);
+
+				std::wstring signature = GetMethodSignature(pFunction);
+				VTableLayout::Slot slot;
+				slot.table = layout.tables.size();
+				if (!isIntro) {
+					LONG thisAdjust = 0;
+					pFunction->get_thisAdjust(&thisAdjust);
+					for (size_t i = 0; i < layout.tables.size(); i++) {
+						const VTableLayout::Table& table = layout.tables[i];
+						if (!table.slotsBySignature.count(signature))
+							continue;
+						if (slot.table == layout.tables.size() || (table.virtualBase.id == 0 && table.vfptrOffset == thisAdjust))
+							slot.table = i;
+					}
+				}
+				if (slot.table != layout.tables.size()) {
+					slot.offset = layout.tables[slot.table].slotsBySignature[signature];
+				}
+				else {
+					slot.table = primaryTable();
+					slot.offset = vtableOffset;
+					layout.tables[slot.table].slotsBySignature[signature] = vtableOffset;
+				}
+
+				DWORD methodId = 0;
+				pFunction->get_symIndexId(&methodId);
+				layout.slotsByMethodId[methodId] = slot;
+			}
+		});
+	}
+
+	return vtableCache.emplace(classId, std::move(layout)).first->second;
+}
+
+// Natural alignment of a member type: scalars align to their size, arrays to their element and
+// classes to their most aligned member. __declspec(align) and #pragma pack are not in the PDB.
+ULONGLONG GetTypeAlignment(IDiaSymbol* pType) {
+	DWORD symTag = 0;
+	pType->get_symTag(&symTag);
+	if (symTag == SymTagUDT)
+		return GetClassLayout(pType).alignment;
+
+	CComPtr<IDiaSymbol> pElementType;
+	if (symTag == SymTagArrayType && pType->get_type(&pElementType) == S_OK && pElementType)
+		return GetTypeAlignment(pElementType);
+
+	ULONGLONG length = 0;
+	pType->get_length(&length);
+	return length != 0 ? (std::min)(length, static_cast<ULONGLONG>(8)) : 1;
+}
 
-DWORD GetSymbolLineNumber(CComPtr<IDiaSymbol> pSymbol) {
-	CComPtr<IDiaLineNumber> pLineNumber;
-	HRESULT hr = pSymbol->getSrcLineOnTypeDefn(&pLineNumber);
-	if (SUCCEEDED(hr) && pLineNumber) {
-		DWORD lineNumber = 0;
-		hr = pLineNumber->get_lineNumber(&lineNumber);
-		if (SUCCEEDED(hr)) {
-			return lineNumber;
+ULONGLONG AlignUp(ULONGLONG value, ULONGLONG alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// Builds (or returns the memoized) layout of a class. Non-virtual bases are copied in at their
+// offset from their own memoized layouts, so each base is enumerated once however many classes
+// derive from it.
+const ClassLayout& GetClassLayout(CComPtr<IDiaSymbol> pUDT) {
+	DWORD classId = 0;
+	pUDT->get_symIndexId(&classId);
+
+	auto& layoutCache = sessionContext->layoutCache;
+	auto it = layoutCache.find(classId);
+	if (it != layoutCache.end())
+		return it->second;
+
+	ClassLayout layout;
+	layout.name = sessionContext->namePools->strings.Intern(GetQualifiedName(pUDT));
+	pUDT->get_length(&layout.size);
+
+	auto addVirtualBase = [&layout](const ClassLayout* virtualBase) {
+		if (std::find(layout.virtualBases.begin(), layout.virtualBases.end(), virtualBase) == layout.virtualBases.end())
+			layout.virtualBases.push_back(virtualBase);
+	};
+
+	// Virtual function table pointers
+	CComPtr<IDiaEnumSymbols> pVTables;
+	if (SUCCEEDED(pUDT->findChildren(SymTagVTable, NULL, nsNone, &pVTables))) {
+		ForEachSymbol(pVTables, [&](IDiaSymbol* pVTable) {
+			LayoutEntry entry;
+			entry.kind = LayoutVfPtr;
+			entry.name = sessionContext->namePools->strings.Intern(L"__vfptr");
+			entry.declaringClass = layout.name;
+			LONG offset = 0;
+			pVTable->get_offset(&offset);
+			entry.offset = offset;
+			entry.size = sessionContext->pointerSize;
+			layout.entries.push_back(entry);
+			layout.alignment = (std::max)(layout.alignment, entry.size);
+		});
+	}
+
+	// Base classes
+	CComPtr<IDiaEnumSymbols> pBaseClasses;
+	if (SUCCEEDED(pUDT->findChildren(SymTagBaseClass, NULL, nsNone, &pBaseClasses))) {
+		ForEachSymbol(pBaseClasses, [&](IDiaSymbol* pBaseClass) {
+			CComPtr<IDiaSymbol> pBaseType;
+			if (pBaseClass->get_type(&pBaseType) == S_OK && pBaseType) {
+				const ClassLayout& baseLayout = GetClassLayout(pBaseType);
+				layout.alignment = (std::max)(layout.alignment, baseLayout.alignment);
+
+				BOOL isVirtual = FALSE;
+				pBaseClass->get_virtualBaseClass(&isVirtual);
+				if (isVirtual) {
+					// The virtual base itself is placed with the complete object; this class only holds the vbptr
+					LONG vbptrOffset = 0;
+					pBaseClass->get_virtualBasePointerOffset(&vbptrOffset);
+					bool hasVbPtr = std::any_of(layout.entries.begin(), layout.entries.end(), [vbptrOffset](const LayoutEntry& entry) {
+						return entry.kind == LayoutVbPtr && entry.offset == vbptrOffset;
+					});
+					if (!hasVbPtr) {
+						LayoutEntry entry;
+						entry.kind = LayoutVbPtr;
+						entry.name = sessionContext->namePools->strings.Intern(L"__vbptr");
+						entry.declaringClass = layout.name;
+						entry.offset = vbptrOffset;
+						entry.size = sessionContext->pointerSize;
+						layout.entries.push_back(entry);
+						layout.alignment = (std::max)(layout.alignment, entry.size);
+					}
+
+					for (const ClassLayout* virtualBase : baseLayout.virtualBases)
+						addVirtualBase(virtualBase);
+					addVirtualBase(&baseLayout);
+				}
+				else {
+					LONG baseOffset = 0;
+					pBaseClass->get_offset(&baseOffset);
+					for (LayoutEntry entry : baseLayout.entries) {
+						entry.offset += baseOffset;
+						layout.entries.push_back(entry);
+					}
+					for (const ClassLayout* virtualBase : baseLayout.virtualBases)
+						addVirtualBase(virtualBase);
+				}
+			}
+		});
+	}
+
+	// Own non-static data members, including bitfields
+	CComPtr<IDiaEnumSymbols> pDataMembers;
+	if (SUCCEEDED(pUDT->findChildren(SymTagData, NULL, nsNone, &pDataMembers))) {
+		ForEachSymbol(pDataMembers, [&](IDiaSymbol* pDataMember) {
+			DWORD locationType = 0;
+			pDataMember->get_locationType(&locationType);
+			if (locationType == LocIsThisRel || locationType == LocIsBitField) {
+				LayoutEntry entry;
+				entry.name = sessionContext->namePools->strings.Intern(GetScratchName(pDataMember));
+				entry.declaringClass = layout.name;
+
+				CComPtr<IDiaSymbol> pType;
+				pDataMember->get_type(&pType);
+				if (pType) {
+					entry.typeName = ResolveType(pType).name;
+					pType->get_length(&entry.size);
+					layout.alignment = (std::max)(layout.alignment, GetTypeAlignment(pType));
+				}
+
+				LONG offset = 0;
+				pDataMember->get_offset(&offset);
+				entry.offset = offset;
+
+				if (locationType == LocIsBitField) {
+					entry.isBitField = true;
+					pDataMember->get_bitPosition(&entry.bitPosition);
+					pDataMember->get_length(&entry.bitWidth);
+				}
+				layout.entries.push_back(entry);
+			}
+		});
+	}
+
+	std::stable_sort(layout.entries.begin(), layout.entries.end(), [](const LayoutEntry& a, const LayoutEntry& b) {
+		return a.offset != b.offset ? a.offset < b.offset : a.bitPosition < b.bitPosition;
+	});
+
+	// Without virtual bases the whole class is its non-virtual part; otherwise the virtual bases
+	// follow the entries, which end at the last member rounded up to the class's alignment
+	if (layout.virtualBases.empty()) {
+		layout.nonVirtualSize = layout.size;
+	}
+	else {
+		for (const LayoutEntry& entry : layout.entries)
+			layout.nonVirtualSize = (std::max)(layout.nonVirtualSize, static_cast<ULONGLONG>(entry.offset) + entry.size);
+		layout.nonVirtualSize = AlignUp(layout.nonVirtualSize, layout.alignment);
+	}
+
+	return layoutCache.emplace(classId, std::move(layout)).first->second;
+}
+
+// Complete-object layout of a class: the non-virtual part, then virtual bases, then padding holes.
+// The PDB doesn't record where virtual bases end up, so they are placed as MSVC does: after the
+// non-virtual part in order, each occupying its own non-virtual part at its alignment. That is
+// only trusted if it ends exactly at the size of the class; otherwise, as when a vtordisp field
+// precedes a base, each virtual base is listed once without an offset instead of guessing.
+json BuildFlattenedLayout(const ClassLayout& layout) {
+	std::vector<LayoutEntry> entries = layout.entries;
+
+	std::vector<LONGLONG> virtualBaseOffsets;
+	ULONGLONG virtualBaseEnd = layout.nonVirtualSize;
+	for (const ClassLayout* virtualBase : layout.virtualBases) {
+		virtualBaseEnd = AlignUp(virtualBaseEnd, virtualBase->alignment);
+		virtualBaseOffsets.push_back(static_cast<LONGLONG>(virtualBaseEnd));
+		virtualBaseEnd += virtualBase->nonVirtualSize;
+	}
+	bool placeVirtualBases = AlignUp(virtualBaseEnd, layout.alignment) == layout.size;
+
+	if (placeVirtualBases) {
+		for (size_t i = 0; i < layout.virtualBases.size(); i++) {
+			for (LayoutEntry entry : layout.virtualBases[i]->entries) {
+				entry.offset += virtualBaseOffsets[i];
+				entry.inVirtualBase = true;
+				entries.push_back(entry);
+			}
 		}
 	}
-	return 0;
+
+	std::stable_sort(entries.begin(), entries.end(), [](const LayoutEntry& a, const LayoutEntry& b) {
+		return a.offset != b.offset ? a.offset < b.offset : a.bitPosition < b.bitPosition;
+	});
+
+	// Gaps between covered byte ranges are padding; unions and bitfields sharing a storage unit overlap
+	json layoutArray = json::array();
+	LONGLONG coveredEnd = 0;
+	auto addPadding = [&layoutArray](LONGLONG offset, LONGLONG size) {
+		json paddingObject;
+		paddingObject["Kind"] = "Padding";
+		paddingObject["Offset"] = offset;
+		paddingObject["Size"] = size;
+		layoutArray.push_back(paddingObject);
+	};
+
+	for (const LayoutEntry& entry : entries) {
+		if (entry.offset > coveredEnd)
+			addPadding(coveredEnd, entry.offset - coveredEnd);
+
+		json entryObject;
+		switch (entry.kind) {
+		case LayoutVfPtr:
+			entryObject["Kind"] = "VfPtr";
+			break;
+		case LayoutVbPtr:
+			entryObject["Kind"] = "VbPtr";
+			break;
+		default:
+			entryObject["Kind"] = "Field";
+			break;
+		}
+		entryObject["Name"] = std::string(entry.name.utf8);
+		if (!entry.typeName.utf8.empty())
+			entryObject["Type"] = std::string(entry.typeName.utf8);
+		entryObject["DeclaringClass"] = std::string(entry.declaringClass.utf8);
+		entryObject["Offset"] = entry.offset;
+		entryObject["Size"] = entry.size;
+		if (entry.isBitField) {
+			entryObject["BitPosition"] = entry.bitPosition;
+			entryObject["BitWidth"] = entry.bitWidth;
+		}
+		if (entry.inVirtualBase)
+			entryObject["IsVirtualBase"] = true;
+		layoutArray.push_back(entryObject);
+
+		coveredEnd = (std::max)(coveredEnd, entry.offset + static_cast<LONGLONG>(entry.size));
+	}
+
+	if (!placeVirtualBases) {
+		if (static_cast<LONGLONG>(layout.nonVirtualSize) > coveredEnd)
+			addPadding(coveredEnd, static_cast<LONGLONG>(layout.nonVirtualSize) - coveredEnd);
+		for (const ClassLayout* virtualBase : layout.virtualBases) {
+			json virtualBaseObject;
+			virtualBaseObject["Kind"] = "VirtualBase";
+			virtualBaseObject["Name"] = std::string(virtualBase->name.utf8);
+			virtualBaseObject["Size"] = virtualBase->nonVirtualSize;
+			layoutArray.push_back(virtualBaseObject);
+		}
+		return layoutArray;
+	}
+
+	if (static_cast<LONGLONG>(layout.size) > coveredEnd)
+		addPadding(coveredEnd, static_cast<LONGLONG>(layout.size) - coveredEnd);
+
+	return layoutArray;
 }
 
-std::wstring GetBasicTypeName(DWORD baseType, DWORD length) {
-	switch (baseType) {
-	case btVoid:
-		return L"void";
-	case btChar:
-		return L"char";
-	case btWChar:
-		return L"wchar_t";
-	case btInt:
-		if (length == 1) return L"int8_t";
-		else if (length == 2) return L"int16_t";
-		else if (length == 4) return L"int32_t";
-		else if (length == 8) return L"int64_t";
-		else return L"int";
-	case btUInt:
-		if (length == 1) return L"uint8_t";
-		else if (length == 2) return L"uint16_t";
-		else if (length == 4) return L"uint32_t";
-		else if (length == 8) return L"uint64_t";
-		else return L"unsigned int";
-	case btFloat:
-		if (length == 4) return L"float";
-		else if (length == 8) return L"double";
-		else if (length == 10) return L"long double";
-		else return L"float";
-	case btBool:
-		return L"bool";
-	case btLong:
-		return L"long";
-	case btULong:
-		return L"unsigned long";
+const char* GetSymTagName(DWORD symTag) {
+	switch (symTag) {
+	case SymTagUDT:
+		return "UDT";
+	case SymTagEnum:
+		return "Enum";
+	case SymTagFunctionType:
+		return "Function";
+	case SymTagPointerType:
+		return "Pointer";
+	case SymTagArrayType:
+		return "Array";
+	case SymTagBaseType:
+		return "Base";
+	case SymTagTypedef:
+		return "Typedef";
+	case SymTagVTableShape:
+		return "VTableShape";
 	default:
-		return L"unknown";
+		return "Other";
 	}
 }
 
-std::wstring GetTypeName(CComPtr<IDiaSymbol> pType) {
-	if (!pType)
-		return L"";
+// Emits every type resolved by any session as a compact descriptor, ordered by type ID so the
+// output is stable. Sessions resolve overlapping sets of types; equal IDs are the same type.
+// Default-valued members are left out to keep the table small.
+json BuildTypeDescriptorsArray(const std::vector<const SessionContext*>& contexts) {
+	std::map<ULONGLONG, const ResolvedType*> types;
+	for (const SessionContext* context : contexts) {
+		for (const auto& entry : context->typeCache)
+			types.emplace(entry.second.typeId, &entry.second);
+	}
 
-	DWORD typeId = 0;
-	pType->get_symIndexId(&typeId);
+	json typesArray = json::array();
+	for (const auto& entry : types) {
+		const TypeDescriptor& descriptor = entry.second->descriptor;
 
-	{
-		// Lock the cache mutex
-		std::lock_guard<std::mutex> lock(cacheMutex);
+		json typeObject;
+		typeObject["Id"] = entry.first;
+		typeObject["Name"] = std::string(entry.second->name.utf8);
+		typeObject["Kind"] = GetSymTagName(descriptor.kind);
+		if (descriptor.baseTypeId != entry.first)
+			typeObject["BaseTypeId"] = descriptor.baseTypeId;
+		if (descriptor.pointerDepth != 0)
+			typeObject["PointerDepth"] = descriptor.pointerDepth;
+		if (descriptor.isReference)
+			typeObject["IsReference"] = true;
+		if (!descriptor.arrayDimensions.empty())
+			typeObject["ArrayDimensions"] = descriptor.arrayDimensions;
+		if (descriptor.cvFlags != 0)
+			typeObject["CvFlags"] = descriptor.cvFlags;
+		if (descriptor.baseCvFlags != 0)
+			typeObject["BaseCvFlags"] = descriptor.baseCvFlags;
+		if (std::any_of(descriptor.pointerCvFlags.begin(), descriptor.pointerCvFlags.end(), [](DWORD flags) { return flags != 0; }))
+			typeObject["PointerCvFlags"] = descriptor.pointerCvFlags;
+		typeObject["Size"] = descriptor.size;
 
-		// Check if the type name is already in the cache
-		auto it = typeNameCache.find(typeId);
-		if (it != typeNameCache.end()) {
-			return it->second;
+		typesArray.push_back(typeObject);
+	}
+	return typesArray;
+}
+
+// TemplateNameInterner
+
+// True if the '<' or '>' at `pos` belongs to an operator name such as "operator<<" or "operator->"
+bool IsOperatorBracket(const std::wstring& name, size_t begin, size_t pos) {
+	size_t start = pos;
+	while (start > begin && (name[start - 1] == L'<' || name[start - 1] == L'>' || name[start - 1] == L'-' || name[start - 1] == L'='))
+		start--;
+	return start - begin >= 8 && name.compare(start - 8, 8, L"operator") == 0;
+}
+
+size_t TemplateNameInterner::NodeKeyHash::operator()(const Node& node) const {
+	size_t hash = std::hash<const void*>()(node.text);
+	hash = hash * 31 + (node.hasArgs ? 1 : 0) + (node.spaceBeforeClose ? 2 : 0);
+	for (NodeId arg : node.args)
+		hash = hash * 31 + arg;
+	return hash * 31 + node.rest;
+}
+
+bool TemplateNameInterner::NodeKeyEqual::operator()(const Node& a, const Node& b) const {
+	return a.text == b.text && a.hasArgs == b.hasArgs && a.spaceBeforeClose == b.spaceBeforeClose &&
+		a.args == b.args && a.rest == b.rest;
+}
+
+TemplateNameInterner::NodeId TemplateNameInterner::Intern(const std::wstring& name) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto it = nameIds.find(name);
+	if (it != nameIds.end())
+		return it->second;
+
+	// Distinct spellings only, which is what storing each name as a plain string would cost
+	requestedBytes += name.size() * sizeof(wchar_t);
+
+	NodeId id = InternLocked(name, 0, name.size());
+
+	// Anything that doesn't round-trip exactly is kept verbatim rather than risk changing a name
+	std::wstring spelling;
+	RenderLocked(id, spelling);
+	if (spelling != name) {
+		Node node;
+		node.text = &*texts.insert(name).first;
+		id = InternNodeLocked(std::move(node));
+	}
+
+	// The lookup table keeps its own copy of the spelling, which counts as stored too
+	nameIds.emplace(name, id);
+	internedBytes += name.size() * sizeof(wchar_t) + sizeof(NodeId);
+	return id;
+}
+
+TemplateNameInterner::NodeId TemplateNameInterner::InternLocked(const std::wstring& name, size_t begin, size_t end) {
+	if (begin >= end)
+		return InvalidNode;
+
+	// Find the first '<' that opens a template argument list
+	size_t open = begin;
+	while (open < end && (name[open] != L'<' || IsOperatorBracket(name, begin, open)))
+		open++;
+
+	Node node;
+	node.text = &*texts.insert(name.substr(begin, open - begin)).first;
+	if (open == end)
+		return InternNodeLocked(std::move(node));
+
+	// Split the argument list at top-level commas
+	node.hasArgs = true;
+	int angleDepth = 0;
+	int parenDepth = 0;
+	size_t argBegin = open + 1;
+	size_t pos = open + 1;
+	for (; pos < end; pos++) {
+		wchar_t c = name[pos];
+		if (c == L'(' || c == L'[')
+			parenDepth++;
+		else if ((c == L')' || c == L']') && parenDepth > 0)
+			parenDepth--;
+		else if (parenDepth != 0 || ((c == L'<' || c == L'>') && IsOperatorBracket(name, argBegin, pos)))
+			continue;
+		else if (c == L'<')
+			angleDepth++;
+		else if (c == L'>') {
+			if (angleDepth == 0)
+				break;
+			angleDepth--;
+		}
+		else if (angleDepth == 0 && c == L',') {
+			node.args.push_back(InternLocked(name, argBegin, pos));
+			argBegin = pos + 1;
 		}
 	}
-	
+	if (pos == end)
+		return InvalidNode; // Unbalanced; Intern() falls back to the verbatim spelling
 
-	DWORD symTag = 0;
-	pType->get_symTag(&symTag);
-	std::wstring typeName;
+	size_t argEnd = pos;
+	if (argEnd > argBegin && name[argEnd - 1] == L' ') {
+		node.spaceBeforeClose = true;
+		argEnd--;
+	}
+	if (argEnd > argBegin || !node.args.empty())
+		node.args.push_back(InternLocked(name, argBegin, argEnd));
 
-	if (symTag == SymTagPointerType) {
-		CComPtr<IDiaSymbol> pBaseType;
-		pType->get_type(&pBaseType);
-		std::wstring baseTypeName = GetTypeName(pBaseType);
-		typeName = baseTypeName + L"*";
+	node.rest = InternLocked(name, pos + 1, end);
+	return InternNodeLocked(std::move(node));
+}
+
+TemplateNameInterner::NodeId TemplateNameInterner::InternNodeLocked(Node&& node) {
+	auto it = nodeIds.find(node);
+	if (it != nodeIds.end())
+		return it->second;
+
+	internedBytes += node.text->size() * sizeof(wchar_t) + node.args.size() * sizeof(NodeId) + sizeof(Node);
+
+	NodeId id = static_cast<NodeId>(nodes.size());
+	nodes.push_back(node);
+	canonicalSpellings.emplace_back();
+	canonicalComputed.push_back(false);
+	nodeIds.emplace(std::move(node), id);
+	return id;
+}
+
+TemplateNameInterner::NodeId TemplateNameInterner::InternTextLocked(const std::wstring& text) {
+	auto it = nameIds.find(text);
+	if (it != nameIds.end())
+		return it->second;
+
+	NodeId id = InternLocked(text, 0, text.size());
+	nameIds.emplace(text, id);
+	internedBytes += text.size() * sizeof(wchar_t) + sizeof(NodeId);
+	return id;
+}
+
+std::wstring TemplateNameInterner::Render(NodeId id) {
+	std::lock_guard<std::mutex> lock(mutex);
+	std::wstring spelling;
+	RenderLocked(id, spelling);
+	return spelling;
+}
+
+void TemplateNameInterner::RenderLocked(NodeId id, std::wstring& out) {
+	while (id != InvalidNode) {
+		const Node& node = nodes[id];
+		out += *node.text;
+		if (node.hasArgs) {
+			out += L'<';
+			for (size_t i = 0; i < node.args.size(); i++) {
+				if (i != 0)
+					out += L',';
+				RenderLocked(node.args[i], out);
+			}
+			out += node.spaceBeforeClose ? L" >" : L">";
+		}
+		id = node.rest;
 	}
-	else if (symTag == SymTagArrayType) {
-		CComPtr<IDiaSymbol> pBaseType;
-		pType->get_type(&pBaseType);
-		DWORD count = 0;
-		pType->get_count(&count);
-		std::wstring baseTypeName = GetTypeName(pBaseType);
-		typeName = baseTypeName + L"[" + std::to_wstring(count) + L"]";
+}
+
+std::wstring TemplateNameInterner::RenderCanonical(NodeId id) {
+	std::lock_guard<std::mutex> lock(mutex);
+	return RenderCanonicalLocked(id);
+}
+
+const std::wstring& TemplateNameInterner::RenderCanonicalLocked(NodeId id) {
+	if (canonicalComputed[id])
+		return canonicalSpellings[id];
+
+	// Well-known instantiations that have a standard alias
+	static const std::pair<const wchar_t*, const wchar_t*> aliases[] = {
+		{ L"std::basic_string<char,std::char_traits<char>,std::allocator<char> >", L"std::string" },
+		{ L"std::basic_string<wchar_t,std::char_traits<wchar_t>,std::allocator<wchar_t> >", L"std::wstring" },
+		{ L"std::basic_string<char16_t,std::char_traits<char16_t>,std::allocator<char16_t> >", L"std::u16string" },
+		{ L"std::basic_string<char32_t,std::char_traits<char32_t>,std::allocator<char32_t> >", L"std::u32string" },
+		{ L"std::basic_string_view<char,std::char_traits<char> >", L"std::string_view" },
+		{ L"std::basic_string_view<wchar_t,std::char_traits<wchar_t> >", L"std::wstring_view" },
+		{ L"std::basic_ostream<char,std::char_traits<char> >", L"std::ostream" },
+		{ L"std::basic_istream<char,std::char_traits<char> >", L"std::istream" },
+		{ L"std::basic_iostream<char,std::char_traits<char> >", L"std::iostream" },
+		{ L"std::basic_ostringstream<char,std::char_traits<char>,std::allocator<char> >", L"std::ostringstream" },
+		{ L"std::basic_istringstream<char,std::char_traits<char>,std::allocator<char> >", L"std::istringstream" },
+		{ L"std::basic_stringstream<char,std::char_traits<char>,std::allocator<char> >", L"std::stringstream" },
+		{ L"std::basic_ofstream<char,std::char_traits<char> >", L"std::ofstream" },
+		{ L"std::basic_ifstream<char,std::char_traits<char> >", L"std::ifstream" },
+		{ L"std::basic_fstream<char,std::char_traits<char> >", L"std::fstream" },
+	};
+	if (aliasIds.empty()) {
+		for (const auto& alias : aliases)
+			aliasIds.emplace_back(InternTextLocked(alias.first), alias.second);
 	}
-	else if (symTag == SymTagBaseType) {
-		DWORD baseType;
-		pType->get_baseType(&baseType);
-		ULONGLONG length = 0;
-		pType->get_length(&length);
-		typeName = GetBasicTypeName(baseType, (DWORD)length);
+
+	// Copy what we need: interning below may grow `nodes`
+	const std::wstring* text = nodes[id].text;
+	bool hasArgs = nodes[id].hasArgs;
+	std::vector<NodeId> args = nodes[id].args;
+	NodeId rest = nodes[id].rest;
+
+	std::wstring spelling;
+	NodeId head = InvalidNode;
+	if (hasArgs) {
+		Node headNode = nodes[id];
+		headNode.rest = InvalidNode;
+		head = InternNodeLocked(std::move(headNode));
+	}
+
+	auto alias = std::find_if(aliasIds.begin(), aliasIds.end(), [head](const auto& entry) { return entry.first == head; });
+	if (head != InvalidNode && alias != aliasIds.end()) {
+		spelling = alias->second;
 	}
 	else {
-		// For other types, return the name
-		typeName = GetSymbolName(pType);
+		spelling = *text;
+		if (hasArgs) {
+			// Drop trailing arguments that equal their default
+			size_t argCount = args.size();
+			while (argCount > 0 && IsDefaultArgumentLocked(*text, argCount - 1, nodes[id]))
+				argCount--;
+
+			spelling += L'<';
+			for (size_t i = 0; i < argCount; i++) {
+				if (i != 0)
+					spelling += L',';
+				spelling += RenderCanonicalLocked(args[i]);
+			}
+			spelling += (!spelling.empty() && spelling.back() == L'>') ? L" >" : L">";
+		}
 	}
+	if (rest != InvalidNode)
+		spelling += RenderCanonicalLocked(rest);
 
-	// Cache the type name
-	{
-		// Lock the cache mutex
-		std::lock_guard<std::mutex> lock(cacheMutex);
-		typeNameCache[typeId] = typeName;
+	canonicalSpellings[id] = std::move(spelling);
+	canonicalComputed[id] = true;
+	return canonicalSpellings[id];
+}
+
+// True if argument `argIndex` of a well-known container is the default the compiler filled in
+bool TemplateNameInterner::IsDefaultArgumentLocked(const std::wstring& templateName, size_t argIndex, const Node& node) {
+	std::vector<NodeId> args = node.args;
+	auto spell = [this, &args](size_t index) {
+		std::wstring spelling;
+		RenderLocked(args[index], spelling);
+		return spelling;
+	};
+	auto close = [](const std::wstring& inner) {
+		return inner + ((!inner.empty() && inner.back() == L'>') ? L" >" : L">");
+	};
+
+	std::wstring expected;
+	if (templateName == L"std::vector" || templateName == L"std::list" || templateName == L"std::deque" || templateName == L"std::forward_list") {
+		if (argIndex == 1)
+			expected = close(L"std::allocator<" + spell(0));
+	}
+	else if (templateName == L"std::unique_ptr") {
+		if (argIndex == 1)
+			expected = close(L"std::default_delete<" + spell(0));
+	}
+	else if (templateName == L"std::set" || templateName == L"std::multiset") {
+		if (argIndex == 1)
+			expected = close(L"std::less<" + spell(0));
+		else if (argIndex == 2)
+			expected = close(L"std::allocator<" + spell(0));
+	}
+	else if (templateName == L"std::map" || templateName == L"std::multimap") {
+		if (argIndex == 2)
+			expected = close(L"std::less<" + spell(0));
+		else if (argIndex == 3)
+			expected = close(L"std::allocator<" + close(L"std::pair<" + spell(0) + L" const ," + spell(1)));
+	}
+	else if (templateName == L"std::unordered_set" || templateName == L"std::unordered_multiset") {
+		if (argIndex == 1)
+			expected = close(L"std::hash<" + spell(0));
+		else if (argIndex == 2)
+			expected = close(L"std::equal_to<" + spell(0));
+		else if (argIndex == 3)
+			expected = close(L"std::allocator<" + spell(0));
+	}
+	else if (templateName == L"std::unordered_map" || templateName == L"std::unordered_multimap") {
+		if (argIndex == 2)
+			expected = close(L"std::hash<" + spell(0));
+		else if (argIndex == 3)
+			expected = close(L"std::equal_to<" + spell(0));
+		else if (argIndex == 4)
+			expected = close(L"std::allocator<" + close(L"std::pair<" + spell(0) + L" const ," + spell(1)));
+	}
+
+	if (expected.empty() || argIndex >= args.size())
+		return false;
+
+	// Hash-consing makes structural comparison an ID comparison
+	return InternTextLocked(expected) == args[argIndex];
+}
+
+size_t TemplateNameInterner::GetNodeCount() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return nodes.size() - 1;
+}
+
+// Benchmarks
+
+// Per-symbol cost of walking every global symbol and its children with different fetch batch
+// sizes. Each symbol is touched with get_symTag so that the enumeration can't be skipped.
+void BenchmarkEnumeration(CComPtr<IDiaSymbol> pGlobal) {
+	// The first pass only warms DIA's caches so that batch size 1 isn't charged for them
+	const ULONG batchSizes[] = { 64, 1, 8, 64, 256 };
+
+	for (size_t pass = 0; pass < sizeof(batchSizes) / sizeof(batchSizes[0]); pass++) {
+		ULONG batchSize = batchSizes[pass];
+		CComPtr<IDiaEnumSymbols> pEnumSymbols;
+		if (FAILED(pGlobal->findChildren(SymTagNull, NULL, nsNone, &pEnumSymbols)))
+			return;
+
+		ULONGLONG symbolCount = 0;
+		auto start = std::chrono::steady_clock::now();
+		ForEachSymbol(pEnumSymbols, [&](IDiaSymbol* pSymbol) {
+			DWORD symTag = 0;
+			pSymbol->get_symTag(&symTag);
+			symbolCount++;
+
+			if (symTag == SymTagUDT || symTag == SymTagEnum || symTag == SymTagFunction) {
+				CComPtr<IDiaEnumSymbols> pChildren;
+				if (SUCCEEDED(pSymbol->findChildren(SymTagNull, NULL, nsNone, &pChildren))) {
+					ForEachSymbol(pChildren, [&](IDiaSymbol* pChild) {
+						DWORD childTag = 0;
+						pChild->get_symTag(&childTag);
+						symbolCount++;
+					}, batchSize);
+				}
+			}
+		}, batchSize);
+		auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		if (pass == 0)
+			continue;
+
+		std::wcout << L"batch " << std::setw(4) << batchSize << L": " << symbolCount << L" symbols, "
+			<< std::fixed << std::setprecision(1) << elapsed / 1e6 << L" ms, "
+			<< (symbolCount ? elapsed / symbolCount : 0.0) << L" ns/symbol" << std::endl;
+	}
+}
+
+// Per-symbol cost of extracting every top-level symbol with the scratch arena off and on. The
+// output is built as in a real dump and dropped after every chunk.
+void BenchmarkArena(CComPtr<IDiaSymbol> pGlobal) {
+	// The first pass only fills the type caches so that both settings see the same work
+	const bool arenaSettings[] = { true, false, true };
+
+	for (size_t pass = 0; pass < sizeof(arenaSettings) / sizeof(arenaSettings[0]); pass++) {
+		ScratchArena::enabled = arenaSettings[pass];
+		CComPtr<IDiaEnumSymbols> pEnumSymbols;
+		if (FAILED(pGlobal->findChildren(SymTagNull, NULL, nsNone, &pEnumSymbols)))
+			break;
+
+		ULONGLONG symbolCount = 0;
+#ifdef PDBTOJSON_COUNT_ALLOCATIONS
+		ULONGLONG allocationsBefore = heapAllocationCount;
+		ULONGLONG bytesBefore = heapAllocationBytes;
+#endif
+		auto start = std::chrono::steady_clock::now();
+		{
+			SymbolArrays arrays;
+			ForEachSymbol(pEnumSymbols, [&](IDiaSymbol* pSymbol) {
+				ProcessSymbol(pSymbol, arrays, SymbolFilter());
+				scratchArena.Reset();
+				if (++symbolCount % SymbolsPerChunk == 0)
+					arrays = SymbolArrays();
+			});
+		}
+		auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		if (pass == 0)
+			continue;
+
+		std::wcout << (arenaSettings[pass] ? L"arena on : " : L"arena off: ") << symbolCount << L" symbols, "
+			<< std::fixed << std::setprecision(1) << elapsed / 1e6 << L" ms, "
+			<< (symbolCount ? elapsed / symbolCount : 0.0) << L" ns/symbol";
+#ifdef PDBTOJSON_COUNT_ALLOCATIONS
+		if (symbolCount) {
+			std::wcout << L", " << double(heapAllocationCount - allocationsBefore) / symbolCount << L" allocations/symbol, "
+				<< double(heapAllocationBytes - bytesBefore) / symbolCount << L" bytes/symbol";
+		}
+#endif
+		std::wcout << std::endl;
+	}
+	ScratchArena::enabled = true;
+}
+
+// Cost of extracting the full output against a few --kinds/--fields projections and the one
+// given on the command line. Each configuration enumerates and looks up only what it needs, as
+// in a real dump, and the output is dropped after every chunk.
+void BenchmarkProjection(CComPtr<IDiaSymbol> pGlobal) {
+	struct Configuration {
+		const wchar_t* label;
+		DWORD kinds;
+		DWORD fields;
+	};
+	const Configuration configurations[] = {
+		{ L"full", KindAll, FieldAll },
+		{ L"command line", dumpOptions.kinds, dumpOptions.fields },
+		{ L"Classes: Name,Size", KindClasses, FieldName | FieldSize },
+		{ L"Classes: Name,Size,Fields,Type,Offset", KindClasses, FieldName | FieldSize | FieldFields | FieldType | FieldOffset },
+	};
+	const DWORD configuredKinds = dumpOptions.kinds;
+	const DWORD configuredFields = dumpOptions.fields;
+
+	// The first pass only fills the type caches so that every configuration sees them warm
+	for (size_t pass = 0; pass <= sizeof(configurations) / sizeof(configurations[0]); pass++) {
+		const Configuration& configuration = configurations[pass == 0 ? 0 : pass - 1];
+		dumpOptions.kinds = configuration.kinds;
+		dumpOptions.fields = configuration.fields;
+
+		CComPtr<IDiaEnumSymbols> pEnumSymbols;
+		if (FAILED(pGlobal->findChildren(GetEnumerationTag(), NULL, nsNone, &pEnumSymbols)))
+			break;
+
+		ULONGLONG symbolCount = 0;
+		ULONGLONG recordCount = 0;
+		auto start = std::chrono::steady_clock::now();
+		{
+			SymbolArrays arrays;
+			auto countRecords = [&]() {
+				recordCount += arrays.classes.size() + arrays.enums.size() + arrays.functions.size()
+					+ arrays.globals.size() + arrays.typedefs.size();
+			};
+			ForEachSymbol(pEnumSymbols, [&](IDiaSymbol* pSymbol) {
+				ProcessSymbol(pSymbol, arrays, SymbolFilter());
+				scratchArena.Reset();
+				if (++symbolCount % SymbolsPerChunk == 0) {
+					countRecords();
+					arrays = SymbolArrays();
+				}
+			});
+			countRecords();
+		}
+		auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		if (pass == 0)
+			continue;
+
+		std::wcout << configuration.label << L": " << symbolCount << L" symbols enumerated, "
+			<< recordCount << L" records, " << std::fixed << std::setprecision(1) << elapsed / 1e6 << L" ms" << std::endl;
+	}
+	dumpOptions.kinds = configuredKinds;
+	dumpOptions.fields = configuredFields;
+}
+
+// UTF-16 to UTF-8 conversion as done before the vectorized transcoder: one call to size the
+// result and one to fill it
+std::string WideCharToMultiByteString(const wchar_t* wstr, size_t length) {
+	if (length == 0)
+		return std::string();
+
+	int sizeNeeded = WideCharToMultiByte(CP_UTF8, 0, wstr, (int)length, NULL, 0, NULL, NULL);
+	if (sizeNeeded <= 0)
+		return std::string();
+
+	std::string strTo(sizeNeeded, 0);
+	if (WideCharToMultiByte(CP_UTF8, 0, wstr, (int)length, &strTo[0], sizeNeeded, NULL, NULL) != sizeNeeded)
+		return std::string();
+
+	return strTo;
+}
+
+// Per-string cost of converting the PDB's symbol names and type names to UTF-8 with
+// WideCharToMultiByte and with each transcoder level this CPU supports. Every level's output
+// is checked against WideCharToMultiByte.
+void BenchmarkTranscode(CComPtr<IDiaSymbol> pGlobal) {
+	std::vector<std::wstring> names;
+	std::vector<std::wstring> typeNames;
+	auto collect = [&](IDiaSymbol* pSymbol) {
+		ScratchWString name = GetScratchName(pSymbol);
+		if (!name.empty())
+			names.emplace_back(name.data(), name.size());
+
+		CComPtr<IDiaSymbol> pType;
+		if (pSymbol->get_type(&pType) == S_OK)
+			typeNames.push_back(GetTypeName(pType));
+		scratchArena.Reset();
+	};
+
+	CComPtr<IDiaEnumSymbols> pEnumSymbols;
+	if (FAILED(pGlobal->findChildren(SymTagNull, NULL, nsNone, &pEnumSymbols)))
+		return;
+	ForEachSymbol(pEnumSymbols, [&](IDiaSymbol* pSymbol) {
+		collect(pSymbol);
+		CComPtr<IDiaEnumSymbols> pChildren;
+		if (SUCCEEDED(pSymbol->findChildren(SymTagNull, NULL, nsNone, &pChildren)))
+			ForEachSymbol(pChildren, collect);
+	});
+
+	const std::pair<const wchar_t*, const std::vector<std::wstring>*> corpora[] = {
+		{ L"names", &names },
+		{ L"types", &typeNames },
+	};
+	const wchar_t* levelNames[] = { L"scalar", L"sse2", L"avx2" };
+	const int rounds = 5;
+
+	for (const auto& corpus : corpora) {
+		const std::vector<std::wstring>& strings = *corpus.second;
+		size_t inputBytes = 0;
+		size_t longest = 0;
+		for (const std::wstring& text : strings) {
+			inputBytes += text.size() * sizeof(wchar_t);
+			longest = (std::max)(longest, text.size());
+		}
+		if (strings.empty())
+			continue;
+
+		std::vector<std::string> expected;
+		expected.reserve(strings.size());
+		for (const std::wstring& text : strings)
+			expected.push_back(WideCharToMultiByteString(text.data(), text.size()));
+
+		auto report = [&](const wchar_t* method, double bestNs, size_t mismatches) {
+			std::wcout << corpus.first << L" " << std::left << std::setw(19) << method << std::right << L": "
+				<< strings.size() << L" strings, " << std::fixed << std::setprecision(1)
+				<< bestNs / strings.size() << L" ns/string, " << inputBytes / bestNs * 1e3 << L" MB/s";
+			if (mismatches)
+				std::wcout << L", " << mismatches << L" MISMATCHES";
+			std::wcout << std::endl;
+		};
+		auto time = [&](const std::function<void()>& convertAll) {
+			double bestNs = 0;
+			for (int round = 0; round < rounds; round++) {
+				auto start = std::chrono::steady_clock::now();
+				convertAll();
+				double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+				if (round == 0 || elapsed < bestNs)
+					bestNs = elapsed;
+			}
+			return bestNs;
+		};
+
+		size_t checksum = 0;
+		double bestNs = time([&]() {
+			for (const std::wstring& text : strings)
+				checksum += WideCharToMultiByteString(text.data(), text.size()).size();
+		});
+		report(L"WideCharToMultiByte", bestNs, 0);
+
+		std::vector<char> buffer(longest * 3 + 1);
+		for (int level = TranscodeScalar; level <= transcodeLevel; level++) {
+			size_t mismatches = 0;
+			for (size_t i = 0; i < strings.size(); i++) {
+				size_t length = TranscodeUtf16ToUtf8(strings[i].data(), strings[i].size(), buffer.data(), TranscodeLevel(level));
+				if (expected[i].compare(0, std::string::npos, buffer.data(), length) != 0)
+					mismatches++;
+			}
+
+			bestNs = time([&]() {
+				for (const std::wstring& text : strings)
+					checksum += TranscodeUtf16ToUtf8(text.data(), text.size(), buffer.data(), TranscodeLevel(level));
+			});
+			report(levelNames[level], bestNs, mismatches);
+		}
+
+		bestNs = time([&]() {
+			for (const std::wstring& text : strings)
+				checksum += WStringToString(text).size();
+		});
+		report(L"WStringToString", bestNs, 0);
+
+		// Keeps the conversions from being optimized away
+		if (checksum == 0)
+			std::wcout << std::endl;
+	}
+}
+
+// Addresses per second resolved by PDBDatabase::FindByAddress one at a time and by
+// FindByAddresses in one batch, against a database of the PDB's functions and variables written
+// to a temporary file. The addresses are spread evenly at random over the indexed span.
+void BenchmarkSymbolize(CComPtr<IDiaSymbol> pGlobal) {
+	const bool writeDatabase = dumpOptions.writeDatabase;
+	dumpOptions.writeDatabase = true;
+	DatabaseBuilder builder;
+	CComPtr<IDiaEnumSymbols> pEnumSymbols;
+	if (SUCCEEDED(pGlobal->findChildren(SymTagNull, NULL, nsNone, &pEnumSymbols))) {
+		SymbolArrays arrays;
+		auto addRecords = [&]() {
+			for (size_t i = 0; i < arrays.functions.size(); i++)
+				builder.AddSymbol(PdbDbFunction, arrays.functions[i], arrays.functionRanges[i]);
+			for (size_t i = 0; i < arrays.globals.size(); i++)
+				builder.AddSymbol(PdbDbGlobal, arrays.globals[i], arrays.globalRanges[i]);
+			arrays = SymbolArrays();
+		};
+		ULONGLONG symbolCount = 0;
+		ForEachSymbol(pEnumSymbols, [&](IDiaSymbol* pSymbol) {
+			DWORD symTag = 0;
+			pSymbol->get_symTag(&symTag);
+			if (symTag == SymTagFunction || symTag == SymTagData)
+				ProcessSymbol(pSymbol, arrays, SymbolFilter());
+			scratchArena.Reset();
+			if (++symbolCount % SymbolsPerChunk == 0)
+				addRecords();
+		});
+		addRecords();
+	}
+	dumpOptions.writeDatabase = writeDatabase;
+
+	std::error_code ec;
+	std::filesystem::path databasePath = std::filesystem::temp_directory_path(ec) /
+		(L"PDBToJSON-" + std::to_wstring(GetCurrentProcessId()) + L"-benchmark.pdbdb");
+	PDBDatabase database;
+	if (ec || !builder.Write(databasePath.wstring()) || !database.Open(databasePath.wstring().c_str())) {
+		std::wcerr << L"Failed to write a database to " << databasePath.wstring() << std::endl;
+		std::filesystem::remove(databasePath, ec);
+		return;
+	}
+
+	// The span the address index covers, as the builder selects its ranges
+	uint64_t first = UINT64_MAX;
+	uint64_t last = 0;
+	uint32_t rangeCount = 0;
+	for (uint32_t i = 0; i < database.GetSymbolCount(); i++) {
+		const PdbDbSymbol& symbol = database.GetSymbol(i);
+		if ((symbol.kind == PdbDbFunction || symbol.kind == PdbDbGlobal) && symbol.virtualOffset != 0 && symbol.size != 0 &&
+			symbol.size <= UINT64_MAX - symbol.virtualOffset) {
+			first = (std::min)(first, symbol.virtualOffset);
+			last = (std::max)(last, symbol.virtualOffset + symbol.size);
+			rangeCount++;
+		}
+	}
+
+	if (rangeCount == 0) {
+		std::wcerr << L"No function or variable in the PDB has an address range" << std::endl;
 	}
-	return typeName;
+	else {
+
+		// xorshift64, seeded so that every run looks up the same addresses
+		const size_t addressCount = 1 << 20;
+		std::vector<uint64_t> addresses(addressCount);
+		uint64_t state = 0x9E3779B97F4A7C15ULL;
+		for (uint64_t& address : addresses) {
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			address = first + state % (last - first);
+		}
+
+		std::vector<uint32_t> symbols(addressCount);
+		const int rounds = 5;
+		auto report = [&](const wchar_t* method, const std::function<void()>& lookUpAll) {
+			double bestNs = 0;
+			for (int round = 0; round < rounds; round++) {
+				auto start = std::chrono::steady_clock::now();
+				lookUpAll();
+				double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+				if (round == 0 || elapsed < bestNs)
+					bestNs = elapsed;
+			}
+			size_t found = std::count_if(symbols.begin(), symbols.end(), [](uint32_t symbol) { return symbol != PDBDatabase::NotFound; });
+			std::wcout << std::left << std::setw(15) << method << std::right << L": " << addressCount << L" addresses, "
+				<< found << L" found, " << std::fixed << std::setprecision(1) << bestNs / addressCount << L" ns/address, "
+				<< addressCount / bestNs * 1e3 << L" M addresses/s" << std::endl;
+		};
+
+		std::wcout << rangeCount << L" address ranges over 0x" << std::hex << first << L"-0x" << last << std::dec << std::endl;
+		report(L"FindByAddress", [&]() {
+			for (size_t i = 0; i < addressCount; i++)
+				symbols[i] = database.FindByAddress(addresses[i]);
+		});
+		report(L"FindByAddresses", [&]() {
+			database.FindByAddresses(addresses.data(), addressCount, symbols.data());
+		});
+	}
+
+	database.Close();
+	std::filesystem::remove(databasePath, ec);
+}
+
+int RunBenchmark(const std::wstring& benchmarkName, CComPtr<IDiaSymbol> pGlobal) {
+	if (benchmarkName == L"enumeration") {
+		BenchmarkEnumeration(pGlobal);
+		return 0;
+	}
+	if (benchmarkName == L"arena") {
+		BenchmarkArena(pGlobal);
+		return 0;
+	}
+	if (benchmarkName == L"transcode") {
+		BenchmarkTranscode(pGlobal);
+		return 0;
+	}
+	if (benchmarkName == L"projection") {
+		BenchmarkProjection(pGlobal);
+		return 0;
+	}
+	if (benchmarkName == L"symbolize") {
+		BenchmarkSymbolize(pGlobal);
+		return 0;
+	}
+
+	std::wcerr << L"Unknown benchmark " << benchmarkName << std::endl;
+	return 1;
 }